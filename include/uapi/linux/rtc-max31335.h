@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Userspace interface of the MAX31331/MAX31335 RTC driver
+ *
+ * Copyright (C) 2023 Analog Devices
+ */
+
+#ifndef _UAPI_LINUX_RTC_MAX31335_H
+#define _UAPI_LINUX_RTC_MAX31335_H
+
+#include <linux/types.h>
+
+/*
+ * Sources reported by the /dev/rtcN-events character device, as bit numbers
+ * in struct max31335_event.events.
+ */
+enum max31335_event_type {
+	MAX31335_EVENT_ALARM1,
+	MAX31335_EVENT_ALARM2,
+	MAX31335_EVENT_TIMER,
+	MAX31335_EVENT_TIMESTAMP,
+	MAX31335_EVENT_TEMP_READY,
+	MAX31335_EVENT_TEMP_HIGH,
+	MAX31335_EVENT_TEMP_LOW,
+	MAX31335_EVENT_POWER_FAIL,
+	MAX31335_EVENT_BATTERY_LOW,
+};
+
+/*
+ * Record returned by read() on /dev/rtcN-events. A read returns as many
+ * whole records as fit in the buffer and fails with EINVAL if not even one
+ * does. It blocks until an event arrives unless O_NONBLOCK is set, and
+ * poll() reports POLLIN while records are pending. Once the device is
+ * removed, read() fails with ENODEV and poll() reports POLLHUP.
+ *
+ * @time_ns: CLOCK_MONOTONIC time of the interrupt, in nanoseconds
+ * @events: all sources decoded from one STATUS read, a mask of
+ *	    1 << enum max31335_event_type
+ * @count: number of interrupts merged into this record; timer and
+ *	   temperature ready interrupts are folded into a pending record
+ *	   while the reader lags behind
+ */
+struct max31335_event {
+	__u64 time_ns;
+	__u32 events;
+	__u32 count;
+};
+
+#endif /* _UAPI_LINUX_RTC_MAX31335_H */
@@ -0,0 +1,88 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Tracepoints for the MAX31335 RTC driver
+ *
+ * Copyright (C) 2023 Analog Devices
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM max31335
+
+#if !defined(_RTC_MAX31335_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _RTC_MAX31335_TRACE_H
+
+#include <linux/device.h>
+#include <linux/tracepoint.h>
+
+/* one I2C transaction issued by regmap on behalf of the driver */
+TRACE_EVENT(max31335_xfer,
+
+	TP_PROTO(struct device *dev, unsigned int reg, size_t len, bool write,
+		 u64 duration_ns, int ret),
+
+	TP_ARGS(dev, reg, len, write, duration_ns, ret),
+
+	TP_STRUCT__entry(
+		__string(name, dev_name(dev))
+		__field(unsigned int, reg)
+		__field(size_t, len)
+		__field(bool, write)
+		__field(u64, duration_ns)
+		__field(int, ret)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, dev_name(dev));
+		__entry->reg = reg;
+		__entry->len = len;
+		__entry->write = write;
+		__entry->duration_ns = duration_ns;
+		__entry->ret = ret;
+	),
+
+	TP_printk("%s %s reg=0x%02x len=%zu duration=%lluns ret=%d",
+		  __get_str(name), __entry->write ? "write" : "read",
+		  __entry->reg, __entry->len, __entry->duration_ns,
+		  __entry->ret)
+);
+
+/* one driver operation, with the bus traffic it caused */
+TRACE_EVENT(max31335_op,
+
+	TP_PROTO(struct device *dev, const char *op, u64 xfers, u64 bytes,
+		 u64 duration_ns, int ret),
+
+	TP_ARGS(dev, op, xfers, bytes, duration_ns, ret),
+
+	TP_STRUCT__entry(
+		__string(name, dev_name(dev))
+		__string(op, op)
+		__field(u64, xfers)
+		__field(u64, bytes)
+		__field(u64, duration_ns)
+		__field(int, ret)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, dev_name(dev));
+		__assign_str(op, op);
+		__entry->xfers = xfers;
+		__entry->bytes = bytes;
+		__entry->duration_ns = duration_ns;
+		__entry->ret = ret;
+	),
+
+	TP_printk("%s %s xfers=%llu bytes=%llu duration=%lluns ret=%d",
+		  __get_str(name), __get_str(op), __entry->xfers,
+		  __entry->bytes, __entry->duration_ns, __entry->ret)
+);
+
+#endif /* _RTC_MAX31335_TRACE_H */
+
+/* the driver lives in drivers/rtc, relative to include/trace */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH ../../drivers/rtc
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE rtc-max31335-trace
+
+#include <trace/define_trace.h>
@@ -1,6 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0
 /*
- * RTC driver for the MAX31335
+ * RTC driver for the MAX31331 and MAX31335
  *
  * Copyright (C) 2023 Analog Devices
  *
@@ -14,15 +14,36 @@
 #include <linux/bitops.h>
 #include <linux/clk.h>
 #include <linux/clk-provider.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/fs.h>
+#include <linux/hrtimer.h>
 #include <linux/hwmon.h>
 #include <linux/i2c.h>
 #include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/irq_sim.h>
+#include <linux/irqdomain.h>
+#include <linux/kfifo.h>
 #include <linux/kernel.h>
+#include <linux/kref.h>
+#include <linux/math64.h>
+#include <linux/miscdevice.h>
 #include <linux/module.h>
 #include <linux/of_device.h>
+#include <linux/pm_wakeup.h>
+#include <linux/poll.h>
 #include <linux/regmap.h>
 #include <linux/rtc.h>
+#include <linux/rtc-max31335.h>
+#include <linux/seq_file.h>
+#include <linux/timekeeping.h>
+#include <linux/uaccess.h>
 #include <linux/util_macros.h>
+#include <linux/workqueue.h>
+
+#define CREATE_TRACE_POINTS
+#include "rtc-max31335-trace.h"
 
 /* MAX31335 Register Map */
 #define MAX31335_STATUS1			0x00
@@ -41,7 +62,7 @@
 #define MAX31335_DAY				0x0D
 #define MAX31335_DATE				0x0E
 #define MAX31335_MONTH				0x0F
-#define MAX31335_YEAR				0x0F
+#define MAX31335_YEAR				0x10
 #define MAX31335_ALM1_SEC			0x11
 #define MAX31335_ALM1_MIN			0x12
 #define MAX31335_ALM1_HRS			0x13
@@ -95,6 +116,24 @@
 #define MAX31335_TS3_MONTH			0x5D
 #define MAX31335_TS3_YEAR			0x5E
 #define MAX31335_TS3_FLAGS			0x5F
+#define MAX31335_RAM_START			0x60
+
+/* MAX31331 Register Map, no temperature sensor or timestamp banks */
+#define MAX31331_RTC_RESET			0x02
+#define MAX31331_RTC_CONFIG			0x03
+#define MAX31331_RTC_CONFIG2			0x04
+#define MAX31331_TIMESTAMP_CONFIG		0x05
+#define MAX31331_TIMER_CONFIG			0x06
+#define MAX31331_SECONDS_1_128			0x07
+#define MAX31331_YEAR				0x0E
+#define MAX31331_ALM1_SEC			0x0F
+#define MAX31331_ALM2_MIN			0x15
+#define MAX31331_TIMER_COUNT			0x18
+#define MAX31331_TIMER_INIT			0x19
+#define MAX31331_PWR_MGMT			0x1A
+#define MAX31331_TRICKLE_REG			0x1B
+#define MAX31331_AGING_OFFSET			0x1C
+#define MAX31331_RAM_START			0x2C
 
 /* MAX31335_STATUS1 Bit Definitions */
 #define MAX31335_STATUS1_PSDECT			BIT(7)
@@ -160,6 +199,10 @@
 /* MAX31335_MONTH Bit Definitions */
 #define MAX31335_MONTH_CENTURY			BIT(7)
 
+/* MAX31335_ALMx Bit Definitions */
+#define MAX31335_ALM_MASK			BIT(7)
+#define MAX31335_ALM_DAY_DATE_DY_DT		BIT(6)
+
 /* MAX31335_PWR_MGMT Bit Definitions */
 #define MAX31335_PWR_MGMT_PFVT			BIT(0)
 
@@ -179,457 +222,3398 @@
 #define MAX31335_TS_FLAGS_DINF			BIT(0)
 
 /* MAX31335 Miscellaneous Definitions */
-#define MAX31335_STATUS1_DEFAULT		0x40
 #define MAX31335_RAM_SIZE			64
+#define MAX31331_RAM_SIZE			32
 #define MAX31335_TIME_SIZE			0x07
+#define MAX31335_TIME_HOURS			3
+#define MAX31335_FRAC_PER_SEC			128
+#define MAX31335_NSEC_PER_FRAC			(NSEC_PER_SEC / MAX31335_FRAC_PER_SEC)
+#define MAX31335_TIMER_MAX_MS			(U8_MAX * MSEC_PER_SEC / 16)
+#define MAX31335_AGING_STEP_PPB			100
+#define MAX31335_AGING_TURNOVER			25000
+#define MAX31335_AGING_TEMPCO_MAX		1000
+#define MAX31335_AGING_DELTA_MAX		153000
+#define MAX31335_TS_COUNT			4
+#define MAX31335_TS_SIZE			8
+#define MAX31335_EVENT_RING			16
+
+enum max31335_power_event {
+	MAX31335_POWER_FAIL,
+	MAX31335_BATTERY_LOW,
+};
+
+enum max31335_alarm2_mode {
+	MAX31335_ALARM2_ONCE,
+	MAX31335_ALARM2_MINUTE,
+	MAX31335_ALARM2_HOUR,
+	MAX31335_ALARM2_DAY,
+	MAX31335_ALARM2_WEEK,
+	MAX31335_ALARM2_MONTH,
+};
+
+/* periodic sources, merged into pending records while the reader lags */
+#define MAX31335_EVENT_PERIODIC	(BIT(MAX31335_EVENT_TIMER) | \
+				 BIT(MAX31335_EVENT_TEMP_READY))
+
+/*
+ * State of the events device. Open files may outlive the driver data, so it
+ * is allocated separately and freed with the last reference: one is held by
+ * the driver until the interrupt is gone, one by every open file. The
+ * record layout is in include/uapi/linux/rtc-max31335.h.
+ */
+struct max31335_events {
+	struct kref ref;
+	struct miscdevice misc;
+	DECLARE_KFIFO(fifo, struct max31335_event, MAX31335_EVENT_RING);
+	struct mutex lock;
+	wait_queue_head_t wait;
+	atomic_t merged;
+	atomic_t merged_count;
+	atomic64_t merged_ns;
+	atomic_t dropped;
+	bool gone;
+};
+
+enum max31335_op {
+	MAX31335_OP_READ_TIME,
+	MAX31335_OP_SET_TIME,
+	MAX31335_OP_READ_ALARM,
+	MAX31335_OP_SET_ALARM,
+	MAX31335_OP_IRQ,
+	MAX31335_OP_HWMON_READ,
+	MAX31335_OP_NVMEM_READ,
+	MAX31335_OP_NVMEM_WRITE,
+	MAX31335_OP_NUM,
+};
+
+/*
+ * Per-operation counters. Bus transactions are attributed to an operation
+ * from the device-wide counters sampled around it, so operations running
+ * concurrently may be charged for each other's traffic. A call that caused
+ * no transaction at all was served from the register cache or a shadow.
+ */
+struct max31335_op_stats {
+	u64 calls;
+	u64 errors;
+	u64 hits;
+	u64 xfers;
+	u64 bytes;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+struct max31335_op_ctx {
+	ktime_t start;
+	s64 xfers;
+	s64 bytes;
+};
+
+/*
+ * Per-variant layout. The time keeping, alarm and control blocks have the
+ * same internal layout on all parts and only move, so every access uses a
+ * precomputed base from this table instead of testing the variant.
+ * STATUS1/INT_EN1 are at the same addresses everywhere, and STATUS2/INT_EN2
+ * and the temperature registers only exist with @temp.
+ */
+struct max31335_chip_info {
+	const struct regmap_config *regmap_config;
+	u8 rtc_reset;
+	u8 rtc_config2;
+	u8 timestamp_config;
+	u8 timer_config;
+	u8 timer_init;
+	u8 time;
+	u8 alarm1;
+	u8 alarm2;
+	u8 pwr_mgmt;
+	u8 trickle;
+	u8 aging;
+	u8 ts;
+	u8 ram;
+	u8 ram_size;
+	u8 status_len;
+	bool temp;
+};
 
 #define clk_hw_to_max31335(_hw) container_of(_hw, struct max31335_data, clkout)
 
+/*
+ * Locking: once the RTC is registered, register read-modify-write cycles,
+ * including all INT_EN updates, go through regmap_update_bits() and are
+ * atomic under the regmap lock. The private mutexes below only cover driver
+ * state that has to stay in step with the device (the RAM shadow, the aging
+ * compensation, the timer, Alarm2 and trickle charger settings), so time,
+ * temperature and nvmem reads never wait for each other. The IRQ thread
+ * takes none of them: work that needs one is deferred to a work item.
+ */
 struct max31335_data {
+	const struct max31335_chip_info *chip;
+	struct i2c_client *client;
 	struct regmap *regmap;
+	struct mutex ram_lock;
+	u8 ram[MAX31335_RAM_SIZE];
+	bool ram_valid;
 	struct rtc_device *rtc;
 	struct clk_hw clkout;
+	struct mutex aging_lock;
+	struct work_struct aging_work;
+	long aging_comp;
+	u32 aging_tempco;
+	u32 write_latency_ns;
+	bool precise_set;
+	long set_offset_nsec;
+	bool time_invalid;
+	bool century;
+	struct mutex timer_lock;
+	unsigned int timer_ms;
+	bool timer_repeat;
+	struct mutex alarm2_lock;
+	struct work_struct alarm2_work;
+	struct mutex trickle_lock;
+	unsigned int trickle_reg;
+	time64_t alarm2_time;
+	enum max31335_alarm2_mode alarm2_mode;
+	unsigned long power_events;
+	struct device *hwmon;
+	unsigned long temp_alarms;
+	long temp;
+	bool temp_valid;
+	bool temp_irq;
+	unsigned int temp_tsint;
+	unsigned int suspend_int_en1;
+	unsigned int suspend_int_en2;
+	atomic64_t bus_xfers;
+	atomic64_t bus_bytes;
+	s64 bus_xfers_base;
+	s64 bus_bytes_base;
+	ktime_t irq_stamp;
+	bool single_xfer;
+	u32 xfer_delay_us;
+	bool cache_bypass;
+	spinlock_t stats_lock;
+	struct max31335_op_stats stats[MAX31335_OP_NUM];
+	struct max31335_op_stats irq_latency;
+	struct max31335_events *events;
+	struct max31335_emul *emul;
 };
 
 static const int max31335_clkout_freq[] = { 1, 64, 1024, 32768 };
 
-static u16 max31335_trickle_resistors[] = {3000, 6000, 11000};
+static const char * const max31335_op_names[] = {
+	[MAX31335_OP_READ_TIME] = "read_time",
+	[MAX31335_OP_SET_TIME] = "set_time",
+	[MAX31335_OP_READ_ALARM] = "read_alarm",
+	[MAX31335_OP_SET_ALARM] = "set_alarm",
+	[MAX31335_OP_IRQ] = "irq",
+	[MAX31335_OP_HWMON_READ] = "hwmon_read",
+	[MAX31335_OP_NVMEM_READ] = "nvmem_read",
+	[MAX31335_OP_NVMEM_WRITE] = "nvmem_write",
+};
 
-static bool max31335_volatile_reg(struct device *dev, unsigned int reg)
-{
+static const char * const max31335_alarm2_modes[] = {
+	[MAX31335_ALARM2_ONCE] = "once",
+	[MAX31335_ALARM2_MINUTE] = "minute",
+	[MAX31335_ALARM2_HOUR] = "hour",
+	[MAX31335_ALARM2_DAY] = "day",
+	[MAX31335_ALARM2_WEEK] = "week",
+	[MAX31335_ALARM2_MONTH] = "month",
+};
+
+/* automatic temperature conversion interval in ms, indexed by TSINT */
+static const int max31335_temp_interval[] = {
+	1000, 2000, 4000, 8000, 16000, 32000, 64000, 128000
+};
+
+/* countdown timer source clock, indexed by TIMER_CONFIG.TFS */
+static const int max31335_timer_freq[] = { 1024, 256, 64, 16 };
+
+/*
+ * TRICKLE codes: the resistor is in series with a Schottky diode, and
+ * optionally with an additional standard diode.
+ */
+struct max31335_trickle {
+	u16 ohms;
+	bool diode;
+	u8 code;
+};
+
+static const struct max31335_trickle max31335_trickle_table[] = {
+	{ 3000, false, 1 },
+	{ 6000, false, 2 },
+	{ 11000, false, 3 },
+	{ 3000, true, 4 },
+	{ 6000, true, 5 },
+	{ 11000, true, 6 },
+};
+
+static const struct regmap_range max31335_volatile_ranges[] = {
+	/* interrupt status registers */
+	regmap_reg_range(MAX31335_STATUS1, MAX31335_STATUS1),
+	regmap_reg_range(MAX31335_STATUS2, MAX31335_STATUS2),
 	/* time keeping registers */
-	if (reg >= MAX31335_SECONDS && reg < MAX31335_SECONDS + MAX31335_TIME_SIZE)
-		return true;
+	regmap_reg_range(MAX31335_SECONDS_1_128, MAX31335_YEAR),
+	/* countdown timer */
+	regmap_reg_range(MAX31335_TIMER_COUNT, MAX31335_TIMER_COUNT),
+	/* temperature registers, CONVERT_T self-clears */
+	regmap_reg_range(MAX31335_TS_CONFIG, MAX31335_TS_CONFIG),
+	regmap_reg_range(MAX31335_TEMP_DATA_MSB, MAX31335_TEMP_DATA_LSB),
+	/* timestamp registers */
+	regmap_reg_range(MAX31335_TS0_SEC_1_128, MAX31335_TS3_FLAGS),
+	/* user RAM, shadowed by the driver so bulk accesses stay raw bursts */
+	regmap_reg_range(MAX31335_RAM_START,
+			 MAX31335_RAM_START + MAX31335_RAM_SIZE - 1),
+};
 
-	/* interrupt status register */
-	if (reg == MAX31335_INT_EN1_A1IE)
-		return true;
+static const struct regmap_access_table max31335_volatile_table = {
+	.yes_ranges = max31335_volatile_ranges,
+	.n_yes_ranges = ARRAY_SIZE(max31335_volatile_ranges),
+};
 
-	/* temperature registers */
-	if (reg == MAX31335_TEMP_DATA_MSB || MAX31335_TEMP_DATA_LSB)
-		return true;
-}
+static const struct regmap_range max31335_precious_ranges[] = {
+	/* status flags are cleared when read */
+	regmap_reg_range(MAX31335_STATUS1, MAX31335_STATUS1),
+	regmap_reg_range(MAX31335_STATUS2, MAX31335_STATUS2),
+};
+
+static const struct regmap_access_table max31335_precious_table = {
+	.yes_ranges = max31335_precious_ranges,
+	.n_yes_ranges = ARRAY_SIZE(max31335_precious_ranges),
+};
 
-static const struct regmap_config regmap_config = {
+static const struct regmap_config max31335_regmap_config = {
 	.reg_bits = 8,
 	.val_bits = 8,
-	.max_register = 0x5F,
-	.volatile_reg = max31335_volatile_reg,
+	.max_register = 0x9F,
+	.volatile_table = &max31335_volatile_table,
+	.precious_table = &max31335_precious_table,
+	.cache_type = REGCACHE_RBTREE,
 };
 
-static int max31335_get_hour(u8 hour_reg)
-{
-	int hour;
+static const struct regmap_range max31331_volatile_ranges[] = {
+	regmap_reg_range(MAX31335_STATUS1, MAX31335_STATUS1),
+	regmap_reg_range(MAX31331_SECONDS_1_128, MAX31331_YEAR),
+	regmap_reg_range(MAX31331_TIMER_COUNT, MAX31331_TIMER_COUNT),
+	regmap_reg_range(MAX31331_RAM_START,
+			 MAX31331_RAM_START + MAX31331_RAM_SIZE - 1),
+};
 
-	/* 24Hr mode */
-	if (!FIELD_GET(MAX31335_HOURS_F_24_12, hour_reg))
-		return bcd2bin(hour_reg & 0x3f);
+static const struct regmap_access_table max31331_volatile_table = {
+	.yes_ranges = max31331_volatile_ranges,
+	.n_yes_ranges = ARRAY_SIZE(max31331_volatile_ranges),
+};
 
-	/* 12Hr mode */
-	hour = bcd2bin(hour_reg & 0x1f);
-	if (hour == 12)
-		hour = 0;
+static const struct regmap_range max31331_precious_ranges[] = {
+	regmap_reg_range(MAX31335_STATUS1, MAX31335_STATUS1),
+};
 
-	if (FIELD_GET(MAX31335_HOURS_HR_20_AM_PM, hour_reg))
-		hour += 12;
+static const struct regmap_access_table max31331_precious_table = {
+	.yes_ranges = max31331_precious_ranges,
+	.n_yes_ranges = ARRAY_SIZE(max31331_precious_ranges),
+};
 
-	return hour;
-}
+static const struct regmap_config max31331_regmap_config = {
+	.reg_bits = 8,
+	.val_bits = 8,
+	.max_register = MAX31331_RAM_START + MAX31331_RAM_SIZE - 1,
+	.volatile_table = &max31331_volatile_table,
+	.precious_table = &max31331_precious_table,
+	.cache_type = REGCACHE_RBTREE,
+};
 
-static int max31335_read_time(struct device *dev, struct rtc_time *tm)
-{
-	struct max31335_data *max31335 = dev_get_drvdata(dev);
-	u8 date[7];
-	int ret;
+static const struct max31335_chip_info max31331_chip_info = {
+	.regmap_config = &max31331_regmap_config,
+	.rtc_reset = MAX31331_RTC_RESET,
+	.rtc_config2 = MAX31331_RTC_CONFIG2,
+	.timestamp_config = MAX31331_TIMESTAMP_CONFIG,
+	.timer_config = MAX31331_TIMER_CONFIG,
+	.timer_init = MAX31331_TIMER_INIT,
+	.time = MAX31331_SECONDS_1_128,
+	.alarm1 = MAX31331_ALM1_SEC,
+	.alarm2 = MAX31331_ALM2_MIN,
+	.pwr_mgmt = MAX31331_PWR_MGMT,
+	.trickle = MAX31331_TRICKLE_REG,
+	.aging = MAX31331_AGING_OFFSET,
+	.ram = MAX31331_RAM_START,
+	.ram_size = MAX31331_RAM_SIZE,
+	.status_len = 1,
+};
 
-	ret = regmap_bulk_read(max31335->regmap, MAX31335_SECONDS, date,
-			       sizeof(date));
-	if (ret)
-		return ret;
+static const struct max31335_chip_info max31335_chip_info = {
+	.regmap_config = &max31335_regmap_config,
+	.rtc_reset = MAX31335_RTC_RESET,
+	.rtc_config2 = MAX31335_RTC_CONFIG2,
+	.timestamp_config = MAX31335_TIMESTAMP_CONFIG,
+	.timer_config = MAX31335_TIMER_CONFIG,
+	.timer_init = MAX31335_TIMER_INIT,
+	.time = MAX31335_SECONDS_1_128,
+	.alarm1 = MAX31335_ALM1_SEC,
+	.alarm2 = MAX31335_ALM2_MIN,
+	.pwr_mgmt = MAX31335_PWR_MGMT,
+	.trickle = MAX31335_TRICKLE_REG,
+	.aging = MAX31335_AGING_OFFSET,
+	.ts = MAX31335_TS0_SEC_1_128,
+	.ram = MAX31335_RAM_START,
+	.ram_size = MAX31335_RAM_SIZE,
+	.status_len = 3,
+	.temp = true,
+};
 
-	tm->tm_sec  = bcd2bin(date[0] & 0x7f);
-	tm->tm_min  = bcd2bin(date[1] & 0x7f);
-	tm->tm_hour = max31335_get_hour(date[2]);
-	tm->tm_wday = bcd2bin(date[3] & 0x7) - 1;
-	tm->tm_mday = bcd2bin(date[4] & 0x3f);
-	tm->tm_mon  = bcd2bin(date[5] & 0x1f) - 1;
-	tm->tm_year = bcd2bin(date[6]) + 100;
+static void max31335_bus_account(struct max31335_data *max31335,
+				 unsigned int reg, size_t len, bool write,
+				 ktime_t start, int ret)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
 
-	if (FIELD_GET(MAX31335_MONTH_CENTURY, date[5]))
-		tm->tm_year += 100;
+	atomic64_inc(&max31335->bus_xfers);
+	atomic64_add(len, &max31335->bus_bytes);
 
-	return 0;
+	trace_max31335_xfer(&max31335->client->dev, reg, len, write, ns, ret);
 }
 
-static int max31335_set_time(struct device *dev, struct rtc_time *tm)
+/*
+ * Extra latency added in front of every transaction from debugfs, to model
+ * slower buses or a loaded adapter. It is included in the reported timings.
+ */
+static void max31335_bus_delay(struct max31335_data *max31335)
 {
-	struct max31335_data *max31335 = dev_get_drvdata(dev);
-	u8 date[7];
+	u32 delay = READ_ONCE(max31335->xfer_delay_us);
 
-	date[0] = bin2bcd(tm->tm_sec);
-	date[1] = bin2bcd(tm->tm_min);
-	date[2] = bin2bcd(tm->tm_hour);
-	date[3] = bin2bcd(tm->tm_wday + 1);
-	date[4] = bin2bcd(tm->tm_mday);
-	date[5] = bin2bcd(tm->tm_mon + 1);
-	date[6] = bin2bcd(tm->tm_year % 100);
+	if (delay)
+		fsleep(delay);
+}
+
+#if IS_ENABLED(CONFIG_IRQ_SIM)
+/*
+ * Register model of the device, used in place of the bus for clients
+ * instantiated as max31331_emul or max31335_emul. Devices described by
+ * firmware always talk to the chip. Regmap, the status read and the interrupt
+ * path see the same traffic as with a chip, so transaction counts and
+ * latencies can be measured on any I2C adapter, i2c-stub included, without
+ * hardware.
+ *
+ * The oscillator runs from CLOCK_MONOTONIC and the time registers, the 1/128
+ * s counter and TIMER_COUNT are computed when read. Alarms are matched on
+ * every simulated second, and the countdown timer and automatic temperature
+ * conversions run from hrtimers. INT is an irq_sim interrupt that is raised
+ * when an enabled flag is set and released when STATUS is read. Everything
+ * else is plain storage.
+ */
+#define MAX31335_EMUL_REGS			0xA0
+#define MAX31335_EMUL_TEMP			25000
+#define MAX31335_EMUL_SUFFIX			"_emul"
+
+struct max31335_emul {
+	const struct max31335_chip_info *chip;
+	spinlock_t lock;
+	u8 regs[MAX31335_EMUL_REGS];
+	/* simulated time in ns since the epoch, as of @origin */
+	s64 base_ns;
+	ktime_t origin;
+	bool running;
+	struct hrtimer tick;
+	struct hrtimer timer;
+	ktime_t timer_start;
+	u64 timer_ns;
+	struct hrtimer conv;
+	int irq;
+	bool asserted;
+	u32 bus_hz;
+	int temp;
+};
 
-	if (tm->tm_year >= 200)
-		date[5] |= FIELD_PREP(MAX31335_MONTH_CENTURY, 1);
+static s64 max31335_emul_now(struct max31335_emul *emul)
+{
+	if (!emul->running)
+		return emul->base_ns;
 
-	return regmap_bulk_write(max31335->regmap, MAX31335_SECONDS, date,
-				 sizeof(date));
+	return emul->base_ns +
+	       ktime_to_ns(ktime_sub(ktime_get(), emul->origin));
 }
 
-static int max31335_read_offset(struct device *dev, long *offset)
+static void max31335_emul_rebase(struct max31335_emul *emul, s64 now_ns)
 {
-	struct max31335_data *max31335 = dev_get_drvdata(dev);
-	u32 value;
-	int ret;
+	emul->base_ns = now_ns;
+	emul->origin = ktime_get();
+}
 
-	ret = regmap_read(max31335->regmap, MAX31335_AGING_OFFSET, &value);
-	if (ret)
-		return ret;
+/* time to the next boundary of the simulated second */
+static u64 max31335_emul_to_second(struct max31335_emul *emul)
+{
+	s32 rem;
 
-	*offset = value;
+	div_s64_rem(max31335_emul_now(emul), NSEC_PER_SEC, &rem);
 
-	return 0;
+	return NSEC_PER_SEC - rem;
 }
 
-static int max31335_set_offset(struct device *dev, long offset)
+static void max31335_emul_time_get(struct max31335_emul *emul)
 {
-	struct max31335_data *max31335 = dev_get_drvdata(dev);
-
-	return regmap_write(max31335->regmap, MAX31335_AGING_OFFSET, offset);
+	u8 *regs = &emul->regs[emul->chip->time];
+	struct rtc_time tm;
+	s32 rem;
+
+	rtc_time64_to_tm(div_s64_rem(max31335_emul_now(emul), NSEC_PER_SEC,
+				     &rem), &tm);
+
+	regs[0] = rem / MAX31335_NSEC_PER_FRAC;
+	regs[1] = bin2bcd(tm.tm_sec);
+	regs[2] = bin2bcd(tm.tm_min);
+	regs[3] = bin2bcd(tm.tm_hour);
+	regs[4] = bin2bcd(tm.tm_wday + 1);
+	regs[5] = bin2bcd(tm.tm_mday);
+	regs[6] = bin2bcd(tm.tm_mon + 1);
+	if (tm.tm_year >= 200)
+		regs[6] |= MAX31335_MONTH_CENTURY;
+	regs[7] = bin2bcd(tm.tm_year % 100);
 }
 
-static int max31335_read_alarm(struct device *dev, struct rtc_wkalrm *alrm)
+static void max31335_emul_time_set(struct max31335_emul *emul)
 {
-	struct max31335_data *max31335 = dev_get_drvdata(dev);
-	int ret, ctrl, status;
-	struct rtc_time time;
-	u8 regs[6];
-
-	ret = regmap_bulk_read(max31335->regmap, MAX31335_ALM1_SEC, regs,
-			       sizeof(regs));
-	if (ret)
-		return ret;
-
-	alrm->time.tm_sec  = bcd2bin(regs[0] & 0x7f);
-	alrm->time.tm_min  = bcd2bin(regs[1] & 0x7f);
-	alrm->time.tm_hour = bcd2bin(regs[2] & 0x3f);
-	alrm->time.tm_mday = bcd2bin(regs[3] & 0x3f);
-	alrm->time.tm_mon  = bcd2bin(regs[4] & 0x1f) - 1;
-	alrm->time.tm_year = bcd2bin(regs[5]) + 100;
-
-	ret = max31335_read_time(dev, &time);
-	if (ret)
-		return ret;
+	const u8 *regs = &emul->regs[emul->chip->time];
+	struct rtc_time tm = {
+		.tm_sec = bcd2bin(regs[1] & 0x7f),
+		.tm_min = bcd2bin(regs[2] & 0x7f),
+		.tm_hour = bcd2bin(regs[3] & 0x3f),
+		.tm_mday = bcd2bin(regs[5] & 0x3f),
+		.tm_mon = bcd2bin(regs[6] & 0x1f) - 1,
+		.tm_year = bcd2bin(regs[7]) + 100,
+	};
+
+	if (regs[6] & MAX31335_MONTH_CENTURY)
+		tm.tm_year += 100;
+
+	max31335_emul_rebase(emul, rtc_tm_to_time64(&tm) * NSEC_PER_SEC +
+			     (regs[0] & 0x7f) * MAX31335_NSEC_PER_FRAC);
+}
 
-	if (time.tm_year >= 200)
-		alrm->time.tm_year += 100;
+static unsigned int max31335_emul_timer_freq(unsigned int cfg)
+{
+	return max31335_timer_freq[FIELD_GET(MAX31335_TIMER_CONFIG_TFS, cfg)];
+}
 
-	ret = regmap_read(max31335->regmap, MAX31335_INT_EN1, &ctrl);
-	if (ret)
-		return ret;
+static u8 max31335_emul_timer_count(struct max31335_emul *emul)
+{
+	unsigned int cfg = emul->regs[emul->chip->timer_config];
+	u64 left;
 
-	ret = regmap_read(max31335->regmap, MAX31335_STATUS1, &status);
-	if (ret)
-		return ret;
+	if (!hrtimer_active(&emul->timer))
+		return (cfg & MAX31335_TIMER_CONFIG_TE) ?
+			0 : emul->regs[emul->chip->timer_init];
 
-	alrm->enabled = FIELD_GET(MAX31335_INT_EN1_A1IE, ctrl);
-	alrm->pending = FIELD_GET(MAX31335_STATUS1_A1F, status);
+	left = emul->timer_ns -
+	       min_t(u64, emul->timer_ns,
+		     ktime_to_ns(ktime_sub(ktime_get(), emul->timer_start)));
 
-	return 0;
+	return DIV_ROUND_UP_ULL(left * max31335_emul_timer_freq(cfg),
+				NSEC_PER_SEC);
 }
 
-static int max31335_set_alarm(struct device *dev, struct rtc_wkalrm *alrm)
+/* INT follows the enabled flags; true when it has just been asserted */
+static bool max31335_emul_int(struct max31335_emul *emul)
 {
-	struct max31335_data *max31335 = dev_get_drvdata(dev);
-	unsigned int reg;
-	u8 regs[6];
-	int ret;
+	bool level = emul->regs[MAX31335_STATUS1] &
+		     emul->regs[MAX31335_INT_EN1];
 
-	regs[0] = bin2bcd(alrm->time.tm_sec);
-	regs[1] = bin2bcd(alrm->time.tm_min);
-	regs[2] = bin2bcd(alrm->time.tm_hour);
-	regs[3] = bin2bcd(alrm->time.tm_mday);
-	regs[4] = bin2bcd(alrm->time.tm_mon + 1);
-	regs[5] = bin2bcd(alrm->time.tm_year % 100);
+	if (emul->chip->temp)
+		level |= emul->regs[MAX31335_STATUS2] &
+			 emul->regs[MAX31335_INT_EN2];
 
-	ret = regmap_bulk_write(max31335->regmap, MAX31335_ALM1_SEC,
-				regs, sizeof(regs));
-	if (ret)
-		return ret;
+	if (level == emul->asserted)
+		return false;
 
-	reg = FIELD_PREP(MAX31335_INT_EN1_A1IE, alrm->enabled);
-	return regmap_update_bits(max31335->regmap, MAX31335_INT_EN1,
-				  MAX31335_INT_EN1_A1IE, reg);
-	if (ret)
-		return ret;
+	emul->asserted = level;
 
-	return regmap_update_bits(max31335->regmap, MAX31335_STATUS1,
-				 MAX31335_STATUS1_A1F, 0);
+	return level;
 }
 
-static int max31335_alarm_irq_enable(struct device *dev, unsigned int enabled)
+static void max31335_emul_raise(struct max31335_emul *emul, bool edge)
 {
-	struct max31335_data *max31335 = dev_get_drvdata(dev);
-
-	return regmap_update_bits(max31335->regmap, MAX31335_INT_EN1,
-				  MAX31335_INT_EN1_A1IE, enabled);
+	if (edge && emul->irq > 0)
+		irq_set_irqchip_state(emul->irq, IRQCHIP_STATE_PENDING, true);
 }
 
-static irqreturn_t max31335_handle_irq(int irq, void *dev_id)
+/*
+ * A field matches when its value does or when its mask bit is set; the year
+ * of Alarm1 has no mask bit and is always compared.
+ */
+static bool max31335_emul_alarm_match(const u8 *regs, const int *val,
+				      const u8 *mask, size_t n, size_t masked)
 {
-	struct max31335_data *max31335 = dev_id;
-	struct mutex *lock = &max31335->rtc->ops_lock;
-	int ret, status;
+	size_t i;
 
-	mutex_lock(lock);
+	for (i = 0; i < n; i++) {
+		if (i < masked && regs[i] & MAX31335_ALM_MASK)
+			continue;
 
-	ret = regmap_read(max31335->regmap, MAX31335_STATUS1, &status);
-	if (ret)
-		goto exit;
-
-	if (FIELD_GET(MAX31335_STATUS1_A1F, status)) {
-		ret = regmap_update_bits(max31335->regmap, MAX31335_STATUS1,
-					 MAX31335_STATUS1_A1F, 0);
-		if (ret)
-			goto exit;
-
-		rtc_update_irq(max31335->rtc, 1, RTC_AF | RTC_IRQF);
+		if (bcd2bin(regs[i] & mask[i]) != val[i])
+			return false;
 	}
 
-exit:
-	mutex_unlock(lock);
-
-	return IRQ_HANDLED;
+	return true;
 }
 
-static const struct rtc_class_ops max31335_rtc_ops = {
-	.read_time = max31335_read_time,
-	.set_time = max31335_set_time,
-	.read_offset = max31335_read_offset,
-	.set_offset = max31335_set_offset,
-	.read_alarm = max31335_read_alarm,
-	.set_alarm = max31335_set_alarm,
-	.alarm_irq_enable = max31335_alarm_irq_enable,
-};
-
-static int max31335_trickle_charger_setup(struct device *dev,
-					  struct max31335_data *max31335)
+/* Alarm1 and Alarm2 are compared once per simulated second */
+static enum hrtimer_restart max31335_emul_tick(struct hrtimer *t)
 {
-	u32 ohms;
-	bool diode = false;
-	int i;
+	struct max31335_emul *emul = container_of(t, struct max31335_emul,
+						  tick);
+	static const u8 mask1[] = { 0x7f, 0x7f, 0x3f, 0x3f, 0x1f, 0xff };
+	static const u8 mask2[] = { 0x7f, 0x3f, 0x3f };
+	const u8 *regs;
+	struct rtc_time tm;
+	unsigned long flags;
+	int val[6];
+	bool edge;
+	u64 next;
+
+	spin_lock_irqsave(&emul->lock, flags);
+
+	rtc_time64_to_tm(div_s64(max31335_emul_now(emul), NSEC_PER_SEC), &tm);
+
+	regs = &emul->regs[emul->chip->alarm1];
+	val[0] = tm.tm_sec;
+	val[1] = tm.tm_min;
+	val[2] = tm.tm_hour;
+	val[3] = regs[3] & MAX31335_ALM_DAY_DATE_DY_DT ?
+		 tm.tm_wday + 1 : tm.tm_mday;
+	val[4] = tm.tm_mon + 1;
+	val[5] = tm.tm_year % 100;
+	if (max31335_emul_alarm_match(regs, val, mask1, ARRAY_SIZE(mask1), 5))
+		emul->regs[MAX31335_STATUS1] |= MAX31335_STATUS1_A1F;
+
+	regs = &emul->regs[emul->chip->alarm2];
+	val[0] = tm.tm_min;
+	val[1] = tm.tm_hour;
+	val[2] = regs[2] & MAX31335_ALM_DAY_DATE_DY_DT ?
+		 tm.tm_wday + 1 : tm.tm_mday;
+	if (!tm.tm_sec &&
+	    max31335_emul_alarm_match(regs, val, mask2, ARRAY_SIZE(mask2), 3))
+		emul->regs[MAX31335_STATUS1] |= MAX31335_STATUS1_A2F;
+
+	edge = max31335_emul_int(emul);
+	next = max31335_emul_to_second(emul);
+
+	spin_unlock_irqrestore(&emul->lock, flags);
+
+	max31335_emul_raise(emul, edge);
+
+	/* from now rather than the last expiry, so it never fires early */
+	hrtimer_set_expires(t, ktime_add_ns(ktime_get(), next));
+
+	return HRTIMER_RESTART;
+}
 
-	if (device_property_read_u32(dev, "trickle-resistor-ohms", &ohms))
-		return 0;
+static enum hrtimer_restart max31335_emul_timer(struct hrtimer *t)
+{
+	struct max31335_emul *emul = container_of(t, struct max31335_emul,
+						  timer);
+	unsigned long flags;
+	bool edge, repeat;
+
+	spin_lock_irqsave(&emul->lock, flags);
+	emul->regs[MAX31335_STATUS1] |= MAX31335_STATUS1_TIF;
+	repeat = emul->regs[emul->chip->timer_config] &
+		 MAX31335_TIMER_CONFIG_TRPT;
+	emul->timer_start = ktime_get();
+	edge = max31335_emul_int(emul);
+	spin_unlock_irqrestore(&emul->lock, flags);
+
+	max31335_emul_raise(emul, edge);
+	if (!repeat)
+		return HRTIMER_NORESTART;
+
+	hrtimer_forward_now(t, ns_to_ktime(emul->timer_ns));
+
+	return HRTIMER_RESTART;
+}
 
-	if (device_property_read_bool(dev, "trickle-diode-enable"))
-		diode = true;
+/* one conversion, with the limits compared the way the sensor does */
+static bool max31335_emul_convert(struct max31335_emul *emul)
+{
+	s16 raw = clamp_val(DIV_ROUND_CLOSEST(READ_ONCE(emul->temp), 250), -512,
+			    511) * 64;
+	u8 *regs = emul->regs;
 
-	for (i = 0; i < ARRAY_SIZE(max31335_trickle_resistors); i++)
-		if (ohms == max31335_trickle_resistors[i])
-			break;
+	put_unaligned_be16(raw, &regs[MAX31335_TEMP_DATA_MSB]);
 
-	if (i >= ARRAY_SIZE(max31335_trickle_resistors)) {
-		dev_warn(dev, "invalid trickle resistor value\n");
+	regs[MAX31335_STATUS2] |= MAX31335_STATUS2_TEMP_RDY;
+	if (raw > (s16)get_unaligned_be16(&regs[MAX31335_TEMP_ALARM_HIGH_MSB]))
+		regs[MAX31335_STATUS2] |= MAX31335_STATUS2_OTF;
+	if (raw < (s16)get_unaligned_be16(&regs[MAX31335_TEMP_ALARM_LOW_MSB]))
+		regs[MAX31335_STATUS2] |= MAX31335_STATUS2_UTF;
 
-		return 0;
-	}
+	return max31335_emul_int(emul);
+}
 
-	if (diode)
-		i = i + 4;
-	else
-		i = i + 1;
+static u64 max31335_emul_conv_ns(struct max31335_emul *emul)
+{
+	unsigned int tsint = FIELD_GET(MAX31335_TS_CONFIG_TSINT,
+				       emul->regs[MAX31335_TS_CONFIG]);
 
-	return regmap_write(max31335->regmap, MAX31335_TRICKLE_REG,
-			    FIELD_PREP(MAX31335_TRICKLE_REG_TRICKLE, i) |
-				       MAX31335_TRICKLE_REG_EN_TRICKLE);
+	return (u64)max31335_temp_interval[tsint] * NSEC_PER_MSEC;
 }
 
-static unsigned long max31335_clkout_recalc_rate(struct clk_hw *hw,
-						 unsigned long parent_rate)
+static enum hrtimer_restart max31335_emul_conv(struct hrtimer *t)
 {
-	struct max31335_data *max31335 = clk_hw_to_max31335(hw);
-	unsigned int freq_mask;
-	unsigned int reg;
-	int ret;
+	struct max31335_emul *emul = container_of(t, struct max31335_emul,
+						  conv);
+	unsigned long flags;
+	bool edge, automatic;
+	u64 next;
 
-	ret = regmap_read(max31335->regmap, MAX31335_RTC_CONFIG2, &reg);
-	if (ret)
-		return 0;
+	spin_lock_irqsave(&emul->lock, flags);
+	automatic = emul->regs[MAX31335_TS_CONFIG] & MAX31335_TS_CONFIG_AUTO;
+	edge = automatic && max31335_emul_convert(emul);
+	next = max31335_emul_conv_ns(emul);
+	spin_unlock_irqrestore(&emul->lock, flags);
+
+	max31335_emul_raise(emul, edge);
+	if (!automatic)
+		return HRTIMER_NORESTART;
 
-	freq_mask = __roundup_pow_of_two(ARRAY_SIZE(max31335_clkout_freq)) - 1;
+	hrtimer_forward_now(t, ns_to_ktime(next));
 
-	return max31335_clkout_freq[reg & freq_mask];
+	return HRTIMER_RESTART;
 }
 
-static long max31335_clkout_round_rate(struct clk_hw *hw, unsigned long rate,
-				       unsigned long *prate)
+/* the modelled duration of a transaction of @len data bytes */
+static void max31335_emul_bus_time(struct max31335_emul *emul, size_t len,
+				   bool read)
 {
-	int index;
+	u32 hz = READ_ONCE(emul->bus_hz);
+	u64 bits;
 
-	index = find_closest(rate, max31335_clkout_freq,
-			     ARRAY_SIZE(max31335_clkout_freq));
+	if (!hz)
+		return;
 
-	return max31335_clkout_freq[index];
+	/* address, register and data bytes plus a read address, 9 bits each */
+	bits = (len + 2 + read) * 9;
+	fsleep(DIV_ROUND_UP_ULL(bits * USEC_PER_SEC, hz));
 }
 
-static int max31335_clkout_set_rate(struct clk_hw *hw, unsigned long rate,
-				    unsigned long parent_rate)
+static int max31335_emul_read(struct max31335_emul *emul, u8 reg, u8 *val,
+			      size_t len)
 {
-	struct max31335_data *max31335 = clk_hw_to_max31335(hw);
-	unsigned int freq_mask;
-	int index;
+	const struct max31335_chip_info *chip = emul->chip;
+	unsigned int end = reg + len;
+	unsigned long flags;
+	u8 count;
+
+	if (end > MAX31335_EMUL_REGS)
+		return -EIO;
+
+	max31335_emul_bus_time(emul, len, true);
+
+	spin_lock_irqsave(&emul->lock, flags);
+
+	if (reg < chip->time + MAX31335_TIME_SIZE + 1 && end > chip->time)
+		max31335_emul_time_get(emul);
+
+	count = max31335_emul_timer_count(emul);
+	emul->regs[chip->timer_init - 1] = count;
+
+	memcpy(val, &emul->regs[reg], len);
+
+	/*
+	 * The status registers are cleared by the read, which releases INT,
+	 * except for PSDECT and OSF. OSF stays set until it is written.
+	 */
+	if (reg == MAX31335_STATUS1) {
+		emul->regs[MAX31335_STATUS1] &= MAX31335_STATUS1_PSDECT |
+						MAX31335_STATUS1_OSF;
+		if (chip->temp && end > MAX31335_STATUS2)
+			emul->regs[MAX31335_STATUS2] = 0;
+		max31335_emul_int(emul);
+	} else if (chip->temp && reg <= MAX31335_STATUS2 &&
+		   end > MAX31335_STATUS2) {
+		emul->regs[MAX31335_STATUS2] = 0;
+		max31335_emul_int(emul);
+	}
 
-	index = find_closest(rate, max31335_clkout_freq,
-			     ARRAY_SIZE(max31335_clkout_freq));
-	freq_mask = __roundup_pow_of_two(ARRAY_SIZE(max31335_clkout_freq)) - 1;
+	spin_unlock_irqrestore(&emul->lock, flags);
 
-	return regmap_update_bits(max31335->regmap, MAX31335_RTC_CONFIG2,
-				  freq_mask, index);
+	return 0;
 }
 
-static int max31335_clkout_enable(struct clk_hw *hw)
+static int max31335_emul_write(struct max31335_emul *emul, u8 reg,
+			       const u8 *val, size_t len)
 {
-	struct max31335_data *max31335 = clk_hw_to_max31335(hw);
+	const struct max31335_chip_info *chip = emul->chip;
+	unsigned int end = reg + len, config = chip->rtc_reset + 1;
+	bool start_timer = false, stop_timer = false;
+	bool start_conv = false, stop_conv = false;
+	bool edge, osc_was, time_touched;
+	unsigned int cfg, old_ts = 0;
+	u8 status1;
+	unsigned long flags;
+	u64 tick = 0;
+
+	if (end > MAX31335_EMUL_REGS)
+		return -EIO;
+
+	max31335_emul_bus_time(emul, len, false);
+
+	spin_lock_irqsave(&emul->lock, flags);
+
+	cfg = emul->regs[chip->timer_config];
+	if (chip->temp)
+		old_ts = emul->regs[MAX31335_TS_CONFIG];
+	osc_was = emul->regs[config] & MAX31335_RTC_CONFIG1_EN_OSC;
+	status1 = emul->regs[MAX31335_STATUS1];
+
+	/* partial writes of the time block keep the other fields running */
+	time_touched = reg < chip->time + MAX31335_TIME_SIZE + 1 &&
+		       end > chip->time;
+	if (time_touched)
+		max31335_emul_time_get(emul);
+
+	memcpy(&emul->regs[reg], val, len);
+
+	/* writing STATUS1 can only clear OSF, the other flags are read-only */
+	if (reg == MAX31335_STATUS1)
+		emul->regs[MAX31335_STATUS1] = status1 &
+			(val[0] | ~MAX31335_STATUS1_OSF);
+
+	if (time_touched) {
+		max31335_emul_time_set(emul);
+		tick = 1;
+	}
 
-	return regmap_set_bits(max31335->regmap, MAX31335_RTC_CONFIG2,
-			       MAX31335_RTC_CONFIG2_ENCLKO);
-}
+	if (reg <= chip->rtc_reset && end > chip->rtc_reset &&
+	    emul->regs[chip->rtc_reset] & MAX31335_RTC_RESET_SWRST) {
+		memset(emul->regs, 0, chip->ram);
+		emul->regs[config] = MAX31335_RTC_CONFIG1_EN_OSC;
+		emul->regs[MAX31335_STATUS1] = MAX31335_STATUS1_OSF;
+		emul->regs[chip->rtc_reset] = MAX31335_RTC_RESET_SWRST;
+		if (chip->temp) {
+			emul->regs[MAX31335_TEMP_ALARM_HIGH_MSB] = 0x7f;
+			emul->regs[MAX31335_TEMP_ALARM_LOW_MSB] = 0x80;
+		}
+		max31335_emul_rebase(emul, mktime64(2000, 1, 1, 0, 0, 0) *
+					   NSEC_PER_SEC);
+	}
 
-static void max31335_clkout_disable(struct clk_hw *hw)
-{
-	struct max31335_data *max31335 = clk_hw_to_max31335(hw);
+	/* stopping the oscillator freezes the time and raises OSF */
+	if (osc_was != !!(emul->regs[config] & MAX31335_RTC_CONFIG1_EN_OSC)) {
+		if (osc_was) {
+			max31335_emul_rebase(emul, max31335_emul_now(emul));
+			emul->regs[MAX31335_STATUS1] |= MAX31335_STATUS1_OSF;
+		} else {
+			emul->origin = ktime_get();
+		}
+		emul->running = !osc_was;
+		tick = 1;
+	}
 
-	regmap_clear_bits(max31335->regmap, MAX31335_RTC_CONFIG2,
-			  MAX31335_RTC_CONFIG2_ENCLKO);
-}
+	if (emul->regs[chip->timer_config] != cfg) {
+		cfg = emul->regs[chip->timer_config];
+		stop_timer = true;
+		start_timer = (cfg & MAX31335_TIMER_CONFIG_TE) &&
+			      !(cfg & MAX31335_TIMER_CONFIG_TPAUSE) &&
+			      emul->regs[chip->timer_init];
+		emul->timer_ns = div_u64((u64)emul->regs[chip->timer_init] *
+					 NSEC_PER_SEC,
+					 max31335_emul_timer_freq(cfg));
+		emul->timer_start = ktime_get();
+	}
 
-static int max31335_clkout_is_enabled(struct clk_hw *hw)
-{
-	struct max31335_data *max31335 = clk_hw_to_max31335(hw);
-	unsigned int reg;
-	int ret;
+	cfg = emul->regs[chip->timestamp_config];
+	if (chip->ts && reg <= chip->timestamp_config &&
+	    end > chip->timestamp_config &&
+	    cfg & MAX31335_TIMESTAMP_CONFIG_TSR) {
+		memset(&emul->regs[chip->ts], 0,
+		       MAX31335_TS_COUNT * MAX31335_TS_SIZE);
+		emul->regs[chip->timestamp_config] &=
+			~MAX31335_TIMESTAMP_CONFIG_TSR;
+	}
 
-	ret = regmap_read(max31335->regmap, MAX31335_RTC_CONFIG2, &reg);
-	if (ret)
-		return ret;
+	edge = false;
+	if (chip->temp && reg <= MAX31335_TS_CONFIG &&
+	    end > MAX31335_TS_CONFIG) {
+		u8 ts = emul->regs[MAX31335_TS_CONFIG];
 
-	return !!(reg & MAX31335_RTC_CONFIG2_ENCLKO);
-}
+		if (ts & MAX31335_TS_CONFIG_CONVERT_T) {
+			emul->regs[MAX31335_TS_CONFIG] &=
+				~MAX31335_TS_CONFIG_CONVERT_T;
+			edge = max31335_emul_convert(emul);
+		}
 
-static const struct clk_ops max31335_clkout_ops = {
-	.recalc_rate = max31335_clkout_recalc_rate,
-	.round_rate = max31335_clkout_round_rate,
-	.set_rate = max31335_clkout_set_rate,
-	.enable = max31335_clkout_enable,
-	.disable = max31335_clkout_disable,
-	.is_enabled = max31335_clkout_is_enabled,
-};
+		if ((ts ^ old_ts) & (MAX31335_TS_CONFIG_AUTO |
+				     MAX31335_TS_CONFIG_TSINT)) {
+			stop_conv = true;
+			start_conv = ts & MAX31335_TS_CONFIG_AUTO;
+		}
+	}
 
-struct clk_init_data max31335_clk_init = {
-	.name = "max31335-clkout",
-	.ops = &max31335_clkout_ops,
-};
+	/* enabling an interrupt whose flag is already set asserts INT */
+	edge |= max31335_emul_int(emul);
+
+	if (tick && emul->running)
+		tick = max31335_emul_to_second(emul);
+	else if (tick)
+		tick = U64_MAX;
+
+	spin_unlock_irqrestore(&emul->lock, flags);
+
+	if (stop_timer)
+		hrtimer_cancel(&emul->timer);
+	if (start_timer)
+		hrtimer_start(&emul->timer, ns_to_ktime(emul->timer_ns),
+			      HRTIMER_MODE_REL);
+
+	if (stop_conv)
+		hrtimer_cancel(&emul->conv);
+	if (start_conv)
+		hrtimer_start(&emul->conv,
+			      ns_to_ktime(max31335_emul_conv_ns(emul)),
+			      HRTIMER_MODE_REL);
+
+	if (tick) {
+		hrtimer_cancel(&emul->tick);
+		if (tick != U64_MAX)
+			hrtimer_start(&emul->tick, ns_to_ktime(tick),
+				      HRTIMER_MODE_REL);
+	}
 
-static int max31335_nvmem_reg_read(void *priv, unsigned int offset,
-				   void *val, size_t bytes)
-{
-	struct max31335_data *max31335 = priv;
-	unsigned int reg = MAX31335_TS0_SEC_1_128 + offset;
+	max31335_emul_raise(emul, edge);
 
-	return regmap_bulk_read(max31335->regmap, reg, val, bytes);
+	return 0;
 }
 
-static int max31335_nvmem_reg_write(void *priv, unsigned int offset,
-				    void *val, size_t bytes)
+static void max31335_emul_stop(void *data)
 {
-	struct max31335_data *max31335 = priv;
-	unsigned int reg = MAX31335_TS0_SEC_1_128 + offset;
+	struct max31335_emul *emul = data;
 
-	return regmap_bulk_write(max31335->regmap, reg, val, bytes);
+	hrtimer_cancel(&emul->tick);
+	hrtimer_cancel(&emul->timer);
+	hrtimer_cancel(&emul->conv);
 }
 
-struct nvmem_config max31335_nvmem_cfg = {
-	.reg_read = max31335_nvmem_reg_read,
-	.reg_write = max31335_nvmem_reg_write,
-	.word_size = 8,
-	.size = MAX31335_RAM_SIZE,
-};
+static void max31335_emul_irq_dispose(void *data)
+{
+	irq_dispose_mapping((unsigned long)data);
+}
 
-static int max31335_read_temp(struct device *dev, enum hwmon_sensor_types type,
-			      u32 attr, int channel, long *val)
+/*
+ * The model powers up like a device that kept its time on the battery:
+ * oscillator running from the system time, no pending flags and the
+ * temperature limits wide open. INT is routed to a simulated interrupt,
+ * replacing any line from firmware, so the IRQ path runs as on a board.
+ */
+static int max31335_emul_init(struct device *dev,
+			      struct max31335_data *max31335)
 {
-	struct max31335_data *max31335 = dev_get_drvdata(dev);
-	u8 reg[2];
-	s16 temp;
+	const struct max31335_chip_info *chip = max31335->chip;
+	struct i2c_client *client = max31335->client;
+	struct max31335_emul *emul;
+	struct irq_domain *domain;
 	int ret;
 
-	if (type != hwmon_temp || attr != hwmon_temp_input)
-		return -EOPNOTSUPP;
+	emul = devm_kzalloc(dev, sizeof(*emul), GFP_KERNEL);
+	if (!emul)
+		return -ENOMEM;
 
-	ret = regmap_bulk_read(max31335->regmap, MAX31335_TEMP_DATA_MSB, reg, 2);
+	emul->chip = chip;
+	emul->temp = MAX31335_EMUL_TEMP;
+	spin_lock_init(&emul->lock);
+	emul->regs[chip->rtc_reset + 1] = MAX31335_RTC_CONFIG1_EN_OSC;
+	if (chip->temp) {
+		emul->regs[MAX31335_TEMP_ALARM_HIGH_MSB] = 0x7f;
+		emul->regs[MAX31335_TEMP_ALARM_LOW_MSB] = 0x80;
+	}
+
+	max31335_emul_rebase(emul, ktime_get_real_ns());
+	emul->running = true;
+
+	domain = devm_irq_domain_create_sim(dev, NULL, 1);
+	if (IS_ERR(domain))
+		return PTR_ERR(domain);
+
+	emul->irq = irq_create_mapping(domain, 0);
+	if (!emul->irq)
+		return -ENXIO;
+
+	ret = devm_add_action_or_reset(dev, max31335_emul_irq_dispose,
+				       (void *)(unsigned long)emul->irq);
 	if (ret)
 		return ret;
 
-	temp = get_unaligned_be16(reg);
+	/* released first, so no timer can raise the mapping once it is gone */
+	hrtimer_init(&emul->tick, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	emul->tick.function = max31335_emul_tick;
+	hrtimer_init(&emul->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	emul->timer.function = max31335_emul_timer;
+	hrtimer_init(&emul->conv, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	emul->conv.function = max31335_emul_conv;
 
-	*val = (temp / 64) * 250;
+	ret = devm_add_action_or_reset(dev, max31335_emul_stop, emul);
+	if (ret)
+		return ret;
 
-	return 0;
-}
+	hrtimer_start(&emul->tick, ns_to_ktime(max31335_emul_to_second(emul)),
+		      HRTIMER_MODE_REL);
+
+	max31335->emul = emul;
+	client->irq = emul->irq;
+
+	dev_info(dev, "emulated device, INT on IRQ %d\n", emul->irq);
+
+	return 0;
+}
+
+/* temperature reported by the model's conversions, in millidegrees */
+static int max31335_emul_temp_get(void *data, u64 *val)
+{
+	struct max31335_emul *emul = data;
+
+	*val = READ_ONCE(emul->temp);
+
+	return 0;
+}
+
+static int max31335_emul_temp_set(void *data, u64 val)
+{
+	struct max31335_emul *emul = data;
+
+	WRITE_ONCE(emul->temp, clamp_val((s64)val, -128000, 127750));
+
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(max31335_emul_temp_fops, max31335_emul_temp_get,
+			 max31335_emul_temp_set, "%lld\n");
+
+static void max31335_emul_debugfs_init(struct max31335_emul *emul,
+				       struct dentry *dir)
+{
+	debugfs_create_u32("emul_bus_hz", 0644, dir, &emul->bus_hz);
+	debugfs_create_file_unsafe("emul_temp", 0644, dir, emul,
+				   &max31335_emul_temp_fops);
+}
+
+/* only clients created by name, never a chip described by firmware */
+static bool max31335_emul_wanted(struct i2c_client *client,
+				 const struct i2c_device_id *id)
+{
+	return id && !dev_fwnode(&client->dev) &&
+	       strstr(id->name, MAX31335_EMUL_SUFFIX);
+}
+
+#define MAX31335_EMUL_ID(name, chip) \
+	{ name MAX31335_EMUL_SUFFIX, (kernel_ulong_t)&(chip) },
+#else
+static int max31335_emul_read(struct max31335_emul *emul, u8 reg, u8 *val,
+			      size_t len)
+{
+	return -ENODEV;
+}
+
+static int max31335_emul_write(struct max31335_emul *emul, u8 reg,
+			       const u8 *val, size_t len)
+{
+	return -ENODEV;
+}
+
+static int max31335_emul_init(struct device *dev,
+			      struct max31335_data *max31335)
+{
+	return -ENODEV;
+}
+
+static void max31335_emul_debugfs_init(struct max31335_emul *emul,
+				       struct dentry *dir)
+{
+}
+
+static bool max31335_emul_wanted(struct i2c_client *client,
+				 const struct i2c_device_id *id)
+{
+	return false;
+}
+
+#define MAX31335_EMUL_ID(name, chip)
+#endif
+
+/*
+ * Plain I2C transfers, as done by regmap-i2c, with every transaction counted
+ * and traced. SMBus-only adapters keep using regmap-i2c without the counters.
+ * Emulated clients send the same transactions to the register model instead.
+ */
+static int max31335_i2c_write(struct max31335_data *max31335, const u8 *data,
+			      size_t count)
+{
+	ktime_t start = ktime_get();
+	int ret;
+
+	max31335_bus_delay(max31335);
+
+	if (max31335->emul)
+		ret = max31335_emul_write(max31335->emul, data[0], data + 1,
+					  count - 1) ?: count;
+	else
+		ret = i2c_master_send(max31335->client, data, count);
+	if (ret == count)
+		ret = 0;
+	else if (ret >= 0)
+		ret = -EIO;
+
+	max31335_bus_account(max31335, data[0], count - 1, true, start, ret);
+
+	return ret;
+}
+
+static int max31335_i2c_read(struct max31335_data *max31335, u8 reg,
+			     void *val, size_t len)
+{
+	struct i2c_client *client = max31335->client;
+	struct i2c_msg xfer[2] = {
+		{
+			.addr = client->addr,
+			.len = 1,
+			.buf = &reg,
+		},
+		{
+			.addr = client->addr,
+			.flags = I2C_M_RD,
+			.len = len,
+			.buf = val,
+		},
+	};
+	ktime_t start = ktime_get();
+	int ret;
+
+	max31335_bus_delay(max31335);
+
+	if (max31335->emul)
+		ret = max31335_emul_read(max31335->emul, reg, val, len) ?:
+		      ARRAY_SIZE(xfer);
+	else
+		ret = i2c_transfer(client->adapter, xfer, ARRAY_SIZE(xfer));
+	if (ret == ARRAY_SIZE(xfer))
+		ret = 0;
+	else if (ret >= 0)
+		ret = -EIO;
+
+	max31335_bus_account(max31335, reg, len, false, start, ret);
+
+	return ret;
+}
+
+/*
+ * With single_xfer set from debugfs, bursts are split into one transaction
+ * per register, to compare against the burst accesses used by the driver.
+ */
+static int max31335_bus_write(void *context, const void *data, size_t count)
+{
+	struct max31335_data *max31335 = context;
+	const u8 *buf = data;
+	size_t i;
+	int ret;
+
+	if (!READ_ONCE(max31335->single_xfer))
+		return max31335_i2c_write(max31335, buf, count);
+
+	for (i = 1; i < count; i++) {
+		u8 single[2] = { buf[0] + i - 1, buf[i] };
+
+		ret = max31335_i2c_write(max31335, single, sizeof(single));
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int max31335_bus_read(void *context, const void *reg, size_t reg_size,
+			     void *val, size_t val_size)
+{
+	struct max31335_data *max31335 = context;
+	u8 addr = *(const u8 *)reg;
+	u8 *buf = val;
+	size_t i;
+	int ret;
+
+	if (!READ_ONCE(max31335->single_xfer))
+		return max31335_i2c_read(max31335, addr, buf, val_size);
+
+	for (i = 0; i < val_size; i++) {
+		ret = max31335_i2c_read(max31335, addr + i, &buf[i], 1);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static const struct regmap_bus max31335_regmap_bus = {
+	.write = max31335_bus_write,
+	.read = max31335_bus_read,
+};
+
+static void max31335_op_begin(struct max31335_data *max31335,
+			      struct max31335_op_ctx *ctx)
+{
+	ctx->xfers = atomic64_read(&max31335->bus_xfers);
+	ctx->bytes = atomic64_read(&max31335->bus_bytes);
+	ctx->start = ktime_get();
+}
+
+static void max31335_op_end(struct max31335_data *max31335,
+			    enum max31335_op op, struct max31335_op_ctx *ctx,
+			    int ret)
+{
+	struct max31335_op_stats *stats = &max31335->stats[op];
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), ctx->start));
+	u64 xfers = atomic64_read(&max31335->bus_xfers) - ctx->xfers;
+	u64 bytes = atomic64_read(&max31335->bus_bytes) - ctx->bytes;
+	unsigned long flags;
+
+	spin_lock_irqsave(&max31335->stats_lock, flags);
+	stats->calls++;
+	stats->errors += ret < 0;
+	stats->hits += !xfers;
+	stats->xfers += xfers;
+	stats->bytes += bytes;
+	stats->total_ns += ns;
+	stats->max_ns = max(stats->max_ns, ns);
+	spin_unlock_irqrestore(&max31335->stats_lock, flags);
+
+	trace_max31335_op(&max31335->client->dev, max31335_op_names[op], xfers,
+			  bytes, ns, ret);
+}
+
+/* run @call as operation @op, evaluating to its return value */
+#define max31335_op(_max31335, _op, _call)				\
+({									\
+	struct max31335_op_ctx __ctx;					\
+	int __ret;							\
+									\
+	max31335_op_begin(_max31335, &__ctx);				\
+	__ret = (_call);						\
+	max31335_op_end(_max31335, _op, &__ctx, __ret);			\
+	__ret;								\
+})
+
+
+/*
+ * BCD layout of the time and Alarm1 blocks. Each entry maps one register to
+ * a struct rtc_time member: value = bcd2bin(reg & mask) - bias. The device
+ * is switched to 24-hour mode once at probe, so no per-call format logic is
+ * needed. Only the time block has a century bit, in MONTH; the Alarm1 block
+ * stores the year modulo 100 and is taken to be in the current century.
+ */
+struct max31335_bcd_field {
+	u8 tm_off;
+	u8 mask;
+	s8 bias;
+};
+
+#define MAX31335_BCD_FIELD(_member, _mask, _bias) \
+	{ offsetof(struct rtc_time, _member), _mask, _bias }
+
+static const struct max31335_bcd_field max31335_time_fields[] = {
+	MAX31335_BCD_FIELD(tm_sec, 0x7f, 0),
+	MAX31335_BCD_FIELD(tm_min, 0x7f, 0),
+	MAX31335_BCD_FIELD(tm_hour, 0x3f, 0),
+	MAX31335_BCD_FIELD(tm_wday, 0x07, 1),
+	MAX31335_BCD_FIELD(tm_mday, 0x3f, 0),
+	MAX31335_BCD_FIELD(tm_mon, 0x1f, 1),
+	MAX31335_BCD_FIELD(tm_year, 0xff, -100),
+};
+
+static const struct max31335_bcd_field max31335_alarm_fields[] = {
+	MAX31335_BCD_FIELD(tm_sec, 0x7f, 0),
+	MAX31335_BCD_FIELD(tm_min, 0x7f, 0),
+	MAX31335_BCD_FIELD(tm_hour, 0x3f, 0),
+	MAX31335_BCD_FIELD(tm_mday, 0x3f, 0),
+	MAX31335_BCD_FIELD(tm_mon, 0x1f, 1),
+	MAX31335_BCD_FIELD(tm_year, 0xff, -100),
+};
+
+static void max31335_bcd_decode(const struct max31335_bcd_field *fields,
+				size_t n, const u8 *regs, bool century,
+				struct rtc_time *tm)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		*(int *)((u8 *)tm + fields[i].tm_off) =
+			bcd2bin(regs[i] & fields[i].mask) - fields[i].bias;
+
+	tm->tm_year += century * 100;
+}
+
+static void max31335_bcd_encode(const struct max31335_bcd_field *fields,
+				size_t n, const struct rtc_time *tm, u8 *regs)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		regs[i] = bin2bcd((*(const int *)((const u8 *)tm +
+						  fields[i].tm_off) +
+				   fields[i].bias) % 100);
+}
+
+/*
+ * Read the time keeping block together with the 1/128 s counter that precedes
+ * it, in a single transaction. The sub-second counter is latched with the
+ * rest of the time registers, so the fraction is coherent with @tm.
+ */
+static int max31335_read_time_frac(struct max31335_data *max31335,
+				   struct rtc_time *tm, unsigned int *frac)
+{
+	u8 date[MAX31335_TIME_SIZE + 1];
+	bool century;
+	int ret;
+
+	ret = regmap_bulk_read(max31335->regmap, max31335->chip->time, date,
+			       sizeof(date));
+	if (ret)
+		return ret;
+
+	if (frac)
+		*frac = date[0] & 0x7f;
+
+	century = FIELD_GET(MAX31335_MONTH_CENTURY, date[6]);
+	WRITE_ONCE(max31335->century, century);
+
+	max31335_bcd_decode(max31335_time_fields,
+			    ARRAY_SIZE(max31335_time_fields), &date[1], century,
+			    tm);
+
+	return 0;
+}
+
+static int max31335_read_time(struct device *dev, struct rtc_time *tm)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+
+	if (max31335->time_invalid)
+		return -EINVAL;
+
+	return max31335_op(max31335, MAX31335_OP_READ_TIME,
+			   max31335_read_time_frac(max31335, tm, NULL));
+}
+
+static int __max31335_set_time(struct max31335_data *max31335,
+			       struct rtc_time *tm)
+{
+	struct rtc_time adj = *tm;
+	struct timespec64 now;
+	unsigned long nsec;
+	u8 date[MAX31335_TIME_SIZE + 1];
+	ktime_t start;
+	time64_t t;
+	u32 latency;
+	int ret;
+
+	/*
+	 * Writing SECONDS_1_128 restarts the sub-second divider, so the first
+	 * increment happens 1 s after the write completes. In precise mode
+	 * set_offset_nsec is 0, so @tm is the time of the current second of
+	 * the system clock, and the 1/128 s phase is set to where that second
+	 * will be once the write lands on the bus. The seconds are the
+	 * caller's, only a carry out of the phase moves them.
+	 */
+	date[0] = 0;
+	if (max31335->precise_set) {
+		ktime_get_real_ts64(&now);
+		nsec = now.tv_nsec + READ_ONCE(max31335->write_latency_ns);
+		if (nsec >= NSEC_PER_SEC) {
+			t = rtc_tm_to_time64(tm) + nsec / NSEC_PER_SEC;
+			rtc_time64_to_tm(t, &adj);
+			nsec %= NSEC_PER_SEC;
+		}
+
+		date[0] = nsec / MAX31335_NSEC_PER_FRAC;
+	}
+
+	/* F_24_12 stays clear, hours are always written in 24-hour mode */
+	max31335_bcd_encode(max31335_time_fields,
+			    ARRAY_SIZE(max31335_time_fields), &adj, &date[1]);
+
+	if (adj.tm_year >= 200)
+		date[6] |= MAX31335_MONTH_CENTURY;
+
+	start = ktime_get();
+	ret = regmap_bulk_write(max31335->regmap, max31335->chip->time, date,
+				sizeof(date));
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(max31335->century, adj.tm_year >= 200);
+
+	/* running average of the bus write latency, weight 1/8 */
+	latency = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (max31335->write_latency_ns)
+		latency = (7 * max31335->write_latency_ns + latency) / 8;
+	WRITE_ONCE(max31335->write_latency_ns, latency);
+
+	/* OSF stays set until written, the other flags are stale anyway */
+	if (max31335->time_invalid) {
+		ret = regmap_write(max31335->regmap, MAX31335_STATUS1, 0);
+		if (ret)
+			return ret;
+
+		max31335->time_invalid = false;
+	}
+
+	return 0;
+}
+
+static int max31335_set_time(struct device *dev, struct rtc_time *tm)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+
+	return max31335_op(max31335, MAX31335_OP_SET_TIME,
+			   __max31335_set_time(max31335, tm));
+}
+
+/*
+ * AGING_OFFSET is a signed step count. As on the DS3231 family, positive
+ * values load the oscillator and slow it down, so the sign is inverted
+ * against the RTC offset convention. Temperature compensation steps added
+ * by max31335_aging_compensate() are not part of the reported offset.
+ */
+static int max31335_read_offset(struct device *dev, long *offset)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+	u32 value;
+	int ret;
+
+	mutex_lock(&max31335->aging_lock);
+	ret = regmap_read(max31335->regmap, max31335->chip->aging, &value);
+	if (!ret)
+		*offset = -((s8)value - max31335->aging_comp) *
+			  MAX31335_AGING_STEP_PPB;
+	mutex_unlock(&max31335->aging_lock);
+
+	return ret;
+}
+
+static int max31335_set_offset(struct device *dev, long offset)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+	long steps;
+	int ret;
+
+	steps = -DIV_ROUND_CLOSEST(offset, MAX31335_AGING_STEP_PPB);
+	if (steps < S8_MIN || steps > S8_MAX)
+		return -ERANGE;
+
+	mutex_lock(&max31335->aging_lock);
+	steps = clamp_val(steps + max31335->aging_comp, S8_MIN, S8_MAX);
+	ret = regmap_write(max31335->regmap, max31335->chip->aging, (u8)steps);
+	mutex_unlock(&max31335->aging_lock);
+
+	return ret;
+}
+
+/*
+ * Optional drift control for the parabolic temperature curve of the
+ * resonator: with a coefficient k in ppb/degC^2 the oscillator runs slow by
+ * k * (T - 25 degC)^2, which is added back through AGING_OFFSET on every
+ * temperature conversion. The register is cached and only written when the
+ * step count changes.
+ */
+static void max31335_aging_compensate(struct max31335_data *max31335,
+				      long temp)
+{
+	u32 tempco = READ_ONCE(max31335->aging_tempco);
+	unsigned int value;
+	s64 delta = temp - MAX31335_AGING_TURNOVER;
+	long comp, steps;
+
+	/*
+	 * With delta clamped to the sensor range and tempco limited to
+	 * MAX31335_AGING_TEMPCO_MAX, the product stays below 2^45.
+	 */
+	delta = clamp_val(delta, -MAX31335_AGING_DELTA_MAX,
+			  MAX31335_AGING_DELTA_MAX);
+	comp = -DIV_S64_ROUND_CLOSEST(tempco * delta * delta,
+				      1000000 * MAX31335_AGING_STEP_PPB);
+
+	mutex_lock(&max31335->aging_lock);
+
+	if (comp == max31335->aging_comp ||
+	    regmap_read(max31335->regmap, max31335->chip->aging, &value))
+		goto unlock;
+
+	steps = (s8)value - max31335->aging_comp + comp;
+	steps = clamp_val(steps, S8_MIN, S8_MAX);
+
+	if (!regmap_write(max31335->regmap, max31335->chip->aging, (u8)steps))
+		WRITE_ONCE(max31335->aging_comp, comp);
+
+unlock:
+	mutex_unlock(&max31335->aging_lock);
+}
+
+/*
+ * Run from a freezable workqueue rather than the IRQ thread, which would
+ * otherwise wait behind a set_offset() holding aging_lock across a write.
+ */
+static void max31335_aging_work(struct work_struct *work)
+{
+	struct max31335_data *max31335 = container_of(work,
+						      struct max31335_data,
+						      aging_work);
+
+	max31335_aging_compensate(max31335, READ_ONCE(max31335->temp));
+}
+
+static int __max31335_read_alarm(struct max31335_data *max31335,
+				 struct rtc_wkalrm *alrm)
+{
+	unsigned int ctrl;
+	u8 regs[6];
+	int ret;
+
+	/*
+	 * The Alarm1 block and INT_EN1 are not volatile and are served from
+	 * the register cache. The alarm shares the century of the current
+	 * time, which is tracked by the time keeping path, so this causes no
+	 * bus traffic at all.
+	 */
+	ret = regmap_bulk_read(max31335->regmap, max31335->chip->alarm1, regs,
+			       sizeof(regs));
+	if (ret)
+		return ret;
+
+	ret = regmap_read(max31335->regmap, MAX31335_INT_EN1, &ctrl);
+	if (ret)
+		return ret;
+
+	max31335_bcd_decode(max31335_alarm_fields,
+			    ARRAY_SIZE(max31335_alarm_fields), regs,
+			    READ_ONCE(max31335->century), &alrm->time);
+
+	/*
+	 * STATUS1 is cleared on read and owned by the interrupt handler, which
+	 * reports A1F as soon as it is raised. Reading it here would steal the
+	 * event, so an alarm is never reported as pending.
+	 */
+	alrm->enabled = FIELD_GET(MAX31335_INT_EN1_A1IE, ctrl);
+	alrm->pending = 0;
+
+	return 0;
+}
+
+static int max31335_read_alarm(struct device *dev, struct rtc_wkalrm *alrm)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+
+	return max31335_op(max31335, MAX31335_OP_READ_ALARM,
+			   __max31335_read_alarm(max31335, alrm));
+}
+
+/*
+ * Update interrupts are delivered by the RTC core through this alarm, which
+ * it moves forward by one second on every event. Only the registers that
+ * differ from the cached Alarm1 block are written, so in that case a single
+ * byte goes out per second.
+ */
+static int __max31335_set_alarm(struct max31335_data *max31335,
+				struct rtc_wkalrm *alrm)
+{
+	unsigned int reg, first, last;
+	u8 regs[6], old[6];
+	int ret;
+
+	/* the alarm has no century bit, it would match 100 years off */
+	if ((alrm->time.tm_year >= 200) != READ_ONCE(max31335->century))
+		return -ERANGE;
+
+	max31335_bcd_encode(max31335_alarm_fields,
+			    ARRAY_SIZE(max31335_alarm_fields), &alrm->time, regs);
+
+	ret = regmap_bulk_read(max31335->regmap, max31335->chip->alarm1, old,
+			       sizeof(old));
+	if (ret)
+		return ret;
+
+	for (first = 0; first < sizeof(regs); first++)
+		if (regs[first] != old[first])
+			break;
+
+	if (first < sizeof(regs)) {
+		for (last = sizeof(regs) - 1; last > first; last--)
+			if (regs[last] != old[last])
+				break;
+
+		ret = regmap_bulk_write(max31335->regmap,
+					max31335->chip->alarm1 + first,
+					&regs[first], last - first + 1);
+		if (ret)
+			return ret;
+	}
+
+	reg = FIELD_PREP(MAX31335_INT_EN1_A1IE, alrm->enabled);
+	return regmap_update_bits(max31335->regmap, MAX31335_INT_EN1,
+				  MAX31335_INT_EN1_A1IE, reg);
+}
+
+static int max31335_set_alarm(struct device *dev, struct rtc_wkalrm *alrm)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+
+	return max31335_op(max31335, MAX31335_OP_SET_ALARM,
+			   __max31335_set_alarm(max31335, alrm));
+}
+
+static int max31335_alarm_irq_enable(struct device *dev, unsigned int enabled)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+
+	return regmap_update_bits(max31335->regmap, MAX31335_INT_EN1,
+				  MAX31335_INT_EN1_A1IE, enabled);
+}
+
+/*
+ * Program the countdown timer for a period of @ms milliseconds, using the
+ * fastest source clock whose 8-bit counter can hold the period. A period of
+ * 0 stops the timer.
+ */
+static int max31335_timer_set(struct max31335_data *max31335, unsigned int ms,
+			      bool repeat)
+{
+	unsigned int count = 0, cfg;
+	int ret, i;
+
+	if (ms > MAX31335_TIMER_MAX_MS)
+		return -ERANGE;
+
+	ret = regmap_write(max31335->regmap, max31335->chip->timer_config, 0);
+	if (ret)
+		return ret;
+
+	if (!ms) {
+		WRITE_ONCE(max31335->timer_ms, 0);
+
+		return regmap_clear_bits(max31335->regmap, MAX31335_INT_EN1,
+					 MAX31335_INT_EN1_TIE);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(max31335_timer_freq); i++) {
+		count = DIV_ROUND_CLOSEST(ms * max31335_timer_freq[i],
+					  MSEC_PER_SEC);
+		if (count <= U8_MAX)
+			break;
+	}
+
+	if (i >= ARRAY_SIZE(max31335_timer_freq))
+		return -ERANGE;
+
+	count = max(count, 1U);
+
+	ret = regmap_write(max31335->regmap, max31335->chip->timer_init, count);
+	if (ret)
+		return ret;
+
+	ret = regmap_set_bits(max31335->regmap, MAX31335_INT_EN1,
+			      MAX31335_INT_EN1_TIE);
+	if (ret)
+		return ret;
+
+	cfg = MAX31335_TIMER_CONFIG_TE | FIELD_PREP(MAX31335_TIMER_CONFIG_TFS, i);
+	if (repeat)
+		cfg |= MAX31335_TIMER_CONFIG_TRPT;
+
+	ret = regmap_write(max31335->regmap, max31335->chip->timer_config, cfg);
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(max31335->timer_repeat, repeat);
+	WRITE_ONCE(max31335->timer_ms,
+		   DIV_ROUND_CLOSEST(count * MSEC_PER_SEC,
+				     max31335_timer_freq[i]));
+
+	return 0;
+}
+
+/*
+ * The IRQ thread must not wait for a sysfs writer holding timer_lock or
+ * alarm2_lock across bus transfers, so the one-shot state is cleared with
+ * cmpxchg() instead: if the timer or Alarm2 was reprogrammed meanwhile, the
+ * stored value no longer matches and the new setting is left alone. A2IE
+ * is cleared later from alarm2_work, under alarm2_lock.
+ */
+static void max31335_timer_event(struct max31335_data *max31335)
+{
+	unsigned int ms = READ_ONCE(max31335->timer_ms);
+
+	if (ms && !READ_ONCE(max31335->timer_repeat))
+		cmpxchg(&max31335->timer_ms, ms, 0);
+
+	sysfs_notify(&max31335->rtc->dev.kobj, NULL, "timer_ms");
+}
+
+/*
+ * Alarm2 is not managed by the RTC core and matches on minutes, hours and
+ * day or date only. Repeating modes mask the fields that are not compared,
+ * so a periodic wakeup needs no reprogramming between events. A time of 0
+ * disables the alarm.
+ */
+static int max31335_alarm2_check(struct max31335_data *max31335, time64_t t,
+				 enum max31335_alarm2_mode mode)
+{
+	struct rtc_time tm;
+	time64_t now;
+	s32 secs;
+	int ret;
+
+	/* there is no seconds register, the alarm fires at :00 */
+	div_s64_rem(t, 60, &secs);
+	if (secs)
+		return -EINVAL;
+
+	if (mode != MAX31335_ALARM2_ONCE)
+		return 0;
+
+	if (max31335->time_invalid)
+		return -EINVAL;
+
+	ret = max31335_read_time_frac(max31335, &tm, NULL);
+	if (ret)
+		return ret;
+
+	/*
+	 * Only minutes, hours and date are compared, so a one-shot alarm goes
+	 * off at the first matching date. Dates repeat 28 days apart at the
+	 * earliest, so closer than that the first match is @t itself.
+	 */
+	now = rtc_tm_to_time64(&tm);
+	if (t <= now || t - now >= 28 * SECS_PER_DAY)
+		return -ERANGE;
+
+	return 0;
+}
+
+static int max31335_alarm2_set(struct max31335_data *max31335, time64_t t,
+			       enum max31335_alarm2_mode mode)
+{
+	struct rtc_time tm;
+	u8 regs[3];
+	int ret;
+
+	if (t) {
+		ret = max31335_alarm2_check(max31335, t, mode);
+		if (ret)
+			return ret;
+	}
+
+	ret = regmap_clear_bits(max31335->regmap, MAX31335_INT_EN1,
+				MAX31335_INT_EN1_A2IE);
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(max31335->alarm2_mode, mode);
+	WRITE_ONCE(max31335->alarm2_time, 0);
+
+	if (!t)
+		return 0;
+
+	rtc_time64_to_tm(t, &tm);
+
+	regs[0] = bin2bcd(tm.tm_min);
+	regs[1] = bin2bcd(tm.tm_hour);
+	regs[2] = bin2bcd(tm.tm_mday);
+
+	switch (mode) {
+	case MAX31335_ALARM2_MINUTE:
+		regs[0] |= MAX31335_ALM_MASK;
+		fallthrough;
+	case MAX31335_ALARM2_HOUR:
+		regs[1] |= MAX31335_ALM_MASK;
+		fallthrough;
+	case MAX31335_ALARM2_DAY:
+		regs[2] |= MAX31335_ALM_MASK;
+		break;
+	case MAX31335_ALARM2_WEEK:
+		regs[2] = bin2bcd(tm.tm_wday + 1) | MAX31335_ALM_DAY_DATE_DY_DT;
+		break;
+	default:
+		break;
+	}
+
+	ret = regmap_bulk_write(max31335->regmap, max31335->chip->alarm2, regs,
+				sizeof(regs));
+	if (ret)
+		return ret;
+
+	ret = regmap_set_bits(max31335->regmap, MAX31335_INT_EN1,
+			      MAX31335_INT_EN1_A2IE);
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(max31335->alarm2_time, t);
+
+	return 0;
+}
+
+/* disarm a fired one-shot alarm, unless it has been set again since */
+static void max31335_alarm2_work(struct work_struct *work)
+{
+	struct max31335_data *max31335 = container_of(work,
+						      struct max31335_data,
+						      alarm2_work);
+
+	mutex_lock(&max31335->alarm2_lock);
+	if (!max31335->alarm2_time)
+		regmap_clear_bits(max31335->regmap, MAX31335_INT_EN1,
+				  MAX31335_INT_EN1_A2IE);
+	mutex_unlock(&max31335->alarm2_lock);
+}
+
+static void max31335_alarm2_event(struct max31335_data *max31335)
+{
+	time64_t t = READ_ONCE(max31335->alarm2_time);
+
+	if (t && READ_ONCE(max31335->alarm2_mode) == MAX31335_ALARM2_ONCE &&
+	    cmpxchg64(&max31335->alarm2_time, t, 0) == t)
+		queue_work(system_freezable_wq, &max31335->alarm2_work);
+
+	sysfs_notify(&max31335->rtc->dev.kobj, NULL, "alarm2");
+}
+
+static void max31335_timestamp_event(struct max31335_data *max31335)
+{
+	sysfs_notify(&max31335->rtc->dev.kobj, NULL, "timestamps");
+}
+
+static int max31335_temp_fetch(struct max31335_data *max31335, long *val)
+{
+	u8 reg[2];
+	s16 temp;
+	int ret;
+
+	ret = regmap_bulk_read(max31335->regmap, MAX31335_TEMP_DATA_MSB, reg, 2);
+	if (ret)
+		return ret;
+
+	temp = get_unaligned_be16(reg);
+
+	*val = (temp / 64) * 250;
+
+	WRITE_ONCE(max31335->temp, *val);
+	WRITE_ONCE(max31335->temp_valid, true);
+
+	return 0;
+}
+
+static void max31335_temp_event(struct max31335_data *max31335)
+{
+	long val;
+
+	if (max31335_temp_fetch(max31335, &val))
+		return;
+
+	if (READ_ONCE(max31335->aging_tempco) ||
+	    READ_ONCE(max31335->aging_comp))
+		queue_work(system_freezable_wq, &max31335->aging_work);
+}
+
+static void max31335_temp_alarm_event(struct max31335_data *max31335,
+				      u32 attr)
+{
+	set_bit(attr, &max31335->temp_alarms);
+
+	if (max31335->hwmon)
+		hwmon_notify_event(max31335->hwmon, hwmon_temp, attr, 0);
+}
+
+/*
+ * Power events are latched for the power_fail/battery_low attributes, which
+ * can be polled, and also sent as a change uevent on the RTC device.
+ */
+static void max31335_power_event(struct max31335_data *max31335,
+				 enum max31335_power_event event)
+{
+	static const char * const attrs[] = {
+		[MAX31335_POWER_FAIL] = "power_fail",
+		[MAX31335_BATTERY_LOW] = "battery_low",
+	};
+	static char *envp[][2] = {
+		[MAX31335_POWER_FAIL] = { "EVENT=POWER_FAIL", NULL },
+		[MAX31335_BATTERY_LOW] = { "EVENT=BATTERY_LOW", NULL },
+	};
+	struct kobject *kobj = &max31335->rtc->dev.kobj;
+
+	set_bit(event, &max31335->power_events);
+	sysfs_notify(kobj, NULL, attrs[event]);
+	kobject_uevent_env(kobj, KOBJ_CHANGE, envp[event]);
+}
+
+/*
+ * STATUS1, INT_EN1 and STATUS2 are fetched with one raw block read. Going
+ * through regmap would split the range into one transaction per register,
+ * because INT_EN1 is cached, and the status registers are volatile so
+ * nothing in the cache is bypassed.
+ */
+static int max31335_status_read(struct max31335_data *max31335, u8 *status)
+{
+	u8 len = max31335->chip->status_len;
+	ktime_t start = ktime_get();
+	int ret;
+
+	max31335_bus_delay(max31335);
+
+	if (max31335->emul)
+		ret = max31335_emul_read(max31335->emul, MAX31335_STATUS1,
+					 status, len) ?: len;
+	else
+		ret = i2c_smbus_read_i2c_block_data(max31335->client,
+						    MAX31335_STATUS1, len,
+						    status);
+	if (ret == len)
+		ret = 0;
+	else if (ret >= 0)
+		ret = -EIO;
+
+	max31335_bus_account(max31335, MAX31335_STATUS1, len, false, start,
+			     ret);
+
+	return ret;
+}
+
+/*
+ * Single producer side of the event ring, called once per STATUS read. The
+ * IRQ thread is the only writer and readers serialize on the events lock,
+ * so the kfifo needs no lock. While records are still pending, interrupts
+ * that only carry periodic sources are folded into counters instead of
+ * taking a slot; they show up in the next record. Readers are woken either
+ * way, a reader that drained the ring meanwhile picks up the merged counts.
+ */
+static void max31335_event_push(struct max31335_data *max31335, u32 events)
+{
+	struct max31335_events *evs = max31335->events;
+	struct max31335_event ev;
+	u64 time_ns = ktime_to_ns(max31335->irq_stamp);
+
+	if (!(events & ~MAX31335_EVENT_PERIODIC) &&
+	    !kfifo_is_empty(&evs->fifo)) {
+		atomic_or(events, &evs->merged);
+		atomic64_set(&evs->merged_ns, time_ns);
+		atomic_inc(&evs->merged_count);
+	} else {
+		ev.time_ns = time_ns;
+		ev.events = events | atomic_xchg(&evs->merged, 0);
+		ev.count = 1 + atomic_xchg(&evs->merged_count, 0);
+
+		if (!kfifo_put(&evs->fifo, ev))
+			atomic_inc(&evs->dropped);
+	}
+
+	wake_up_interruptible_poll(&evs->wait, EPOLLIN | EPOLLRDNORM);
+}
+
+/* account the time from the interrupt edge to the RTC core being told */
+static void max31335_irq_latency(struct max31335_data *max31335)
+{
+	struct max31335_op_stats *stats = &max31335->irq_latency;
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), max31335->irq_stamp));
+	unsigned long flags;
+
+	spin_lock_irqsave(&max31335->stats_lock, flags);
+	stats->calls++;
+	stats->total_ns += ns;
+	stats->max_ns = max(stats->max_ns, ns);
+	spin_unlock_irqrestore(&max31335->stats_lock, flags);
+}
+
+static irqreturn_t __max31335_handle_irq(struct max31335_data *max31335)
+{
+	struct device *dev = regmap_get_device(max31335->regmap);
+	unsigned int int_en1, int_en2;
+	u8 status[3] = { };
+	u8 status1, status2;
+	u32 events = 0;
+	int ret;
+
+	/*
+	 * STATUS1 and STATUS2 are cleared when read, so this read is also the
+	 * acknowledge. A level triggered line stays asserted if it fails, so
+	 * the interrupt is still reported as handled rather than letting the
+	 * spurious interrupt detector shut it off. No RTC core lock is taken,
+	 * rtc_update_irq() does not need it.
+	 */
+	ret = max31335_status_read(max31335, status);
+	if (ret)
+		return IRQ_HANDLED;
+
+	/*
+	 * The enables come from the cache; their bits line up with the flags
+	 * and drop sources that are not enabled as interrupts. STATUS2 and
+	 * INT_EN2 only exist on parts with the temperature sensor.
+	 */
+	if (regmap_read(max31335->regmap, MAX31335_INT_EN1, &int_en1))
+		return IRQ_HANDLED;
+
+	status1 = status[0] & int_en1;
+	status2 = 0;
+	if (max31335->chip->temp) {
+		if (regmap_read(max31335->regmap, MAX31335_INT_EN2, &int_en2))
+			return IRQ_HANDLED;
+
+		status2 = status[2] & int_en2;
+	}
+
+	if (!status1 && !status2)
+		return IRQ_NONE;
+
+	/* power fail first, it is the most time critical event */
+	if (status1 & MAX31335_STATUS1_PFAIL) {
+		max31335_power_event(max31335, MAX31335_POWER_FAIL);
+		events |= BIT(MAX31335_EVENT_POWER_FAIL);
+	}
+
+	if (status1 & MAX31335_STATUS1_VBATLOW) {
+		dev_warn_ratelimited(dev, "backup battery low\n");
+		max31335_power_event(max31335, MAX31335_BATTERY_LOW);
+		events |= BIT(MAX31335_EVENT_BATTERY_LOW);
+	}
+
+	if (status1 & (MAX31335_STATUS1_A1F | MAX31335_STATUS1_A2F |
+		       MAX31335_STATUS1_TIF))
+		pm_wakeup_event(dev, 0);
+
+	if (status1 & MAX31335_STATUS1_A1F) {
+		max31335_irq_latency(max31335);
+		rtc_update_irq(max31335->rtc, 1, RTC_AF | RTC_IRQF);
+		events |= BIT(MAX31335_EVENT_ALARM1);
+	}
+
+	if (status1 & MAX31335_STATUS1_A2F) {
+		max31335_alarm2_event(max31335);
+		events |= BIT(MAX31335_EVENT_ALARM2);
+	}
+
+	if (status1 & MAX31335_STATUS1_TIF) {
+		max31335_timer_event(max31335);
+		events |= BIT(MAX31335_EVENT_TIMER);
+	}
+
+	if (status1 & MAX31335_STATUS1_DIF) {
+		max31335_timestamp_event(max31335);
+		events |= BIT(MAX31335_EVENT_TIMESTAMP);
+	}
+
+	if (status2 & MAX31335_STATUS2_OTF) {
+		max31335_temp_alarm_event(max31335, hwmon_temp_max_alarm);
+		events |= BIT(MAX31335_EVENT_TEMP_HIGH);
+	}
+
+	if (status2 & MAX31335_STATUS2_UTF) {
+		max31335_temp_alarm_event(max31335, hwmon_temp_min_alarm);
+		events |= BIT(MAX31335_EVENT_TEMP_LOW);
+	}
+
+	if (status2 & MAX31335_STATUS2_TEMP_RDY) {
+		max31335_temp_event(max31335);
+		events |= BIT(MAX31335_EVENT_TEMP_READY);
+	}
+
+	/* everything decoded from this read goes out as one record */
+	max31335_event_push(max31335, events);
+
+	return IRQ_HANDLED;
+}
+
+/* stamp the edge in hard IRQ context, the bus is only touched by the thread */
+static irqreturn_t max31335_irq_stamp(int irq, void *dev_id)
+{
+	struct max31335_data *max31335 = dev_id;
+
+	max31335->irq_stamp = ktime_get();
+
+	return IRQ_WAKE_THREAD;
+}
+
+static irqreturn_t max31335_handle_irq(int irq, void *dev_id)
+{
+	struct max31335_data *max31335 = dev_id;
+
+	return max31335_op(max31335, MAX31335_OP_IRQ,
+			   __max31335_handle_irq(max31335));
+}
+
+static int max31335_trickle_reg(u32 ohms, bool diode, unsigned int *reg)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(max31335_trickle_table); i++)
+		if (max31335_trickle_table[i].ohms == ohms &&
+		    max31335_trickle_table[i].diode == diode)
+			break;
+
+	if (i >= ARRAY_SIZE(max31335_trickle_table))
+		return -EINVAL;
+
+	*reg = FIELD_PREP(MAX31335_TRICKLE_REG_TRICKLE,
+			  max31335_trickle_table[i].code) |
+	       MAX31335_TRICKLE_REG_EN_TRICKLE;
+
+	return 0;
+}
+
+/* the register is cached, but it is only written when the setting changes */
+static int max31335_trickle_set(struct max31335_data *max31335,
+				unsigned int reg)
+{
+	int ret = 0;
+
+	mutex_lock(&max31335->trickle_lock);
+	if (reg != max31335->trickle_reg) {
+		ret = regmap_write(max31335->regmap, max31335->chip->trickle,
+				   reg);
+		if (!ret)
+			max31335->trickle_reg = reg;
+	}
+	mutex_unlock(&max31335->trickle_lock);
+
+	return ret;
+}
+
+static ssize_t since_epoch_ns_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+	struct rtc_time tm;
+	unsigned int frac;
+	int ret;
+
+	/* same as read_time: the registers hold no valid time yet */
+	if (max31335->time_invalid)
+		return -EINVAL;
+
+	ret = max31335_read_time_frac(max31335, &tm, &frac);
+	if (ret)
+		return ret;
+
+	return sysfs_emit(buf, "%lld\n",
+			  rtc_tm_to_time64(&tm) * NSEC_PER_SEC +
+			  frac * MAX31335_NSEC_PER_FRAC);
+}
+static DEVICE_ATTR_RO(since_epoch_ns);
+
+static ssize_t precise_set_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+
+	return sysfs_emit(buf, "%d\n", max31335->precise_set);
+}
+
+static ssize_t precise_set_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+	bool enable;
+	int ret;
+
+	ret = kstrtobool(buf, &enable);
+	if (ret)
+		return ret;
+
+	max31335->precise_set = enable;
+
+	/*
+	 * With the phase programmed, the time passed to set_time applies when
+	 * the write is issued rather than one second later, so tell the NTP
+	 * sync not to call ahead of the second boundary.
+	 */
+	WRITE_ONCE(max31335->rtc->set_offset_nsec,
+		   enable ? 0 : max31335->set_offset_nsec);
+
+	return count;
+}
+static DEVICE_ATTR_RW(precise_set);
+
+static ssize_t timer_ms_show(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+
+	return sysfs_emit(buf, "%u\n", max31335->timer_ms);
+}
+
+static ssize_t timer_ms_store(struct device *dev,
+			      struct device_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+	unsigned int ms;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &ms);
+	if (ret)
+		return ret;
+
+	mutex_lock(&max31335->timer_lock);
+	ret = max31335_timer_set(max31335, ms, max31335->timer_repeat);
+	mutex_unlock(&max31335->timer_lock);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(timer_ms);
+
+static ssize_t timer_repeat_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+
+	return sysfs_emit(buf, "%d\n", max31335->timer_repeat);
+}
+
+static ssize_t timer_repeat_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+	bool repeat;
+	int ret;
+
+	ret = kstrtobool(buf, &repeat);
+	if (ret)
+		return ret;
+
+	mutex_lock(&max31335->timer_lock);
+	if (max31335->timer_ms)
+		ret = max31335_timer_set(max31335, max31335->timer_ms, repeat);
+	else
+		WRITE_ONCE(max31335->timer_repeat, repeat);
+	mutex_unlock(&max31335->timer_lock);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(timer_repeat);
+
+static ssize_t alarm2_show(struct device *dev,
+			   struct device_attribute *attr, char *buf)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+
+	return sysfs_emit(buf, "%lld\n", max31335->alarm2_time);
+}
+
+static ssize_t alarm2_store(struct device *dev,
+			    struct device_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+	long long t;
+	int ret;
+
+	ret = kstrtoll(buf, 0, &t);
+	if (ret)
+		return ret;
+
+	if (t && (t < max31335->rtc->range_min || t > max31335->rtc->range_max))
+		return -ERANGE;
+
+	mutex_lock(&max31335->alarm2_lock);
+	ret = max31335_alarm2_set(max31335, t, max31335->alarm2_mode);
+	mutex_unlock(&max31335->alarm2_lock);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(alarm2);
+
+static ssize_t alarm2_mode_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+
+	return sysfs_emit(buf, "%s\n",
+			  max31335_alarm2_modes[max31335->alarm2_mode]);
+}
+
+static ssize_t alarm2_mode_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+	int mode, ret;
+
+	mode = sysfs_match_string(max31335_alarm2_modes, buf);
+	if (mode < 0)
+		return mode;
+
+	mutex_lock(&max31335->alarm2_lock);
+	ret = max31335_alarm2_set(max31335, max31335->alarm2_time, mode);
+	mutex_unlock(&max31335->alarm2_lock);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(alarm2_mode);
+
+static ssize_t offset_tempco_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+
+	return sysfs_emit(buf, "%u\n", max31335->aging_tempco);
+}
+
+static ssize_t offset_tempco_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+	unsigned int tempco;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &tempco);
+	if (ret)
+		return ret;
+
+	if (tempco > MAX31335_AGING_TEMPCO_MAX)
+		return -ERANGE;
+
+	/* applied on the next TEMP_RDY interrupt */
+	WRITE_ONCE(max31335->aging_tempco, tempco);
+
+	return count;
+}
+static DEVICE_ATTR_RW(offset_tempco);
+
+static ssize_t max31335_power_event_show(struct device *dev, char *buf,
+					 enum max31335_power_event event)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+
+	/* latched by the interrupt handler, cleared when read */
+	return sysfs_emit(buf, "%d\n",
+			  test_and_clear_bit(event, &max31335->power_events));
+}
+
+static ssize_t power_fail_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	return max31335_power_event_show(dev, buf, MAX31335_POWER_FAIL);
+}
+static DEVICE_ATTR_RO(power_fail);
+
+static ssize_t battery_low_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return max31335_power_event_show(dev, buf, MAX31335_BATTERY_LOW);
+}
+static DEVICE_ATTR_RO(battery_low);
+
+/*
+ * Charger setting as "off", "<ohms>" or "<ohms> diode", reported from the
+ * value last programmed by the driver.
+ */
+static ssize_t trickle_charger_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+	unsigned int reg = READ_ONCE(max31335->trickle_reg);
+	unsigned int code = FIELD_GET(MAX31335_TRICKLE_REG_TRICKLE, reg);
+	int i;
+
+	if (!(reg & MAX31335_TRICKLE_REG_EN_TRICKLE))
+		return sysfs_emit(buf, "off\n");
+
+	for (i = 0; i < ARRAY_SIZE(max31335_trickle_table); i++)
+		if (max31335_trickle_table[i].code == code)
+			return sysfs_emit(buf, "%u%s\n",
+					  max31335_trickle_table[i].ohms,
+					  max31335_trickle_table[i].diode ?
+					  " diode" : "");
+
+	return sysfs_emit(buf, "unknown\n");
+}
+
+static ssize_t trickle_charger_store(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t count)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+	unsigned int reg = 0;
+	const char *mode;
+	bool diode;
+	u32 ohms;
+	int ret, n;
+
+	if (!sysfs_streq(buf, "off")) {
+		if (sscanf(buf, "%u%n", &ohms, &n) != 1)
+			return -EINVAL;
+
+		/* the resistor may only be followed by " diode" */
+		mode = skip_spaces(buf + n);
+		diode = *mode;
+		if (diode && (mode == buf + n || !sysfs_streq(mode, "diode")))
+			return -EINVAL;
+
+		ret = max31335_trickle_reg(ohms, diode, &reg);
+		if (ret)
+			return ret;
+	}
+
+	ret = max31335_trickle_set(max31335, reg);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(trickle_charger);
+
+/*
+ * Raw image of the four timestamp banks, TS0_SEC_1_128..TS3_FLAGS, eight
+ * bytes each in register order. The banks are volatile and contiguous, so a
+ * full read is a single bus transfer. Pollers are woken on DIF. Any write
+ * clears all banks through TSR, which restarts capture when the banks are
+ * full and adi,ts-overwrite is not set.
+ */
+static ssize_t timestamps_read(struct file *filp, struct kobject *kobj,
+			       struct bin_attribute *attr, char *buf,
+			       loff_t off, size_t count)
+{
+	struct device *dev = kobj_to_dev(kobj);
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+	int ret;
+
+	ret = regmap_bulk_read(max31335->regmap, max31335->chip->ts + off,
+			       buf, count);
+	if (ret)
+		return ret;
+
+	return count;
+}
+
+static ssize_t timestamps_write(struct file *filp, struct kobject *kobj,
+				struct bin_attribute *attr, char *buf,
+				loff_t off, size_t count)
+{
+	struct device *dev = kobj_to_dev(kobj);
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+	unsigned int reg = max31335->chip->timestamp_config;
+	int ret;
+
+	ret = regmap_set_bits(max31335->regmap, reg,
+			      MAX31335_TIMESTAMP_CONFIG_TSR);
+	if (ret)
+		return ret;
+
+	/* TIMESTAMP_CONFIG is cached, TSR must not be replayed from there */
+	ret = regmap_clear_bits(max31335->regmap, reg,
+				MAX31335_TIMESTAMP_CONFIG_TSR);
+	if (ret)
+		return ret;
+
+	return count;
+}
+static BIN_ATTR_RW(timestamps, MAX31335_TS_COUNT * MAX31335_TS_SIZE);
+
+static struct bin_attribute *max31335_bin_attrs[] = {
+	&bin_attr_timestamps,
+	NULL
+};
+
+static struct attribute *max31335_attrs[] = {
+	&dev_attr_since_epoch_ns.attr,
+	&dev_attr_precise_set.attr,
+	&dev_attr_timer_ms.attr,
+	&dev_attr_timer_repeat.attr,
+	&dev_attr_alarm2.attr,
+	&dev_attr_alarm2_mode.attr,
+	&dev_attr_offset_tempco.attr,
+	&dev_attr_power_fail.attr,
+	&dev_attr_battery_low.attr,
+	&dev_attr_trickle_charger.attr,
+	NULL
+};
+
+static umode_t max31335_attr_is_visible(struct kobject *kobj,
+					struct attribute *attr, int n)
+{
+	struct device *dev = kobj_to_dev(kobj);
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+
+	/* drift control is driven by the temperature conversions */
+	if (attr == &dev_attr_offset_tempco.attr && !max31335->chip->temp)
+		return 0;
+
+	return attr->mode;
+}
+
+static umode_t max31335_bin_attr_is_visible(struct kobject *kobj,
+					    struct bin_attribute *attr, int n)
+{
+	struct device *dev = kobj_to_dev(kobj);
+	struct max31335_data *max31335 = dev_get_drvdata(dev->parent);
+
+	return max31335->chip->ts ? attr->attr.mode : 0;
+}
+
+static const struct attribute_group max31335_attr_group = {
+	.attrs = max31335_attrs,
+	.bin_attrs = max31335_bin_attrs,
+	.is_visible = max31335_attr_is_visible,
+	.is_bin_visible = max31335_bin_attr_is_visible,
+};
+
+static const struct rtc_class_ops max31335_rtc_ops = {
+	.read_time = max31335_read_time,
+	.set_time = max31335_set_time,
+	.read_offset = max31335_read_offset,
+	.set_offset = max31335_set_offset,
+	.read_alarm = max31335_read_alarm,
+	.set_alarm = max31335_set_alarm,
+	.alarm_irq_enable = max31335_alarm_irq_enable,
+};
+
+static int max31335_trickle_charger_config(struct device *dev,
+					   unsigned int *reg)
+{
+	bool diode;
+	u32 ohms;
+	int ret;
+
+	if (device_property_read_u32(dev, "trickle-resistor-ohms", &ohms))
+		return -ENOENT;
+
+	diode = device_property_read_bool(dev, "trickle-diode-enable");
+
+	ret = max31335_trickle_reg(ohms, diode, reg);
+	if (ret)
+		dev_err(dev, "unsupported trickle charger setting\n");
+
+	return ret;
+}
+
+/*
+ * CLKO is left gated until a consumer enables it. The rate can be selected
+ * from DT so that it is applied with the initial configuration rather than
+ * through a later set_rate.
+ */
+static int max31335_clkout_config(struct device *dev,
+				  struct max31335_data *max31335,
+				  unsigned int *reg)
+{
+	u32 rate;
+	int ret, i;
+
+	ret = regmap_read(max31335->regmap, max31335->chip->rtc_config2, reg);
+	if (ret)
+		return ret;
+
+	*reg &= ~MAX31335_RTC_CONFIG2_ENCLKO;
+
+	if (device_property_read_u32(dev, "adi,clkout-frequency-hz", &rate))
+		return 0;
+
+	for (i = 0; i < ARRAY_SIZE(max31335_clkout_freq); i++)
+		if (rate == max31335_clkout_freq[i])
+			break;
+
+	if (i >= ARRAY_SIZE(max31335_clkout_freq)) {
+		dev_warn(dev, "invalid clkout frequency\n");
+
+		return 0;
+	}
+
+	*reg &= ~MAX31335_RTC_CONFIG2_CLKO_HZ;
+	*reg |= FIELD_PREP(MAX31335_RTC_CONFIG2_CLKO_HZ, i);
+
+	return 0;
+}
+
+static unsigned int max31335_timestamp_config(struct device *dev)
+{
+	unsigned int cfg = 0;
+
+	if (device_property_read_bool(dev, "adi,ts-din"))
+		cfg |= MAX31335_TIMESTAMP_CONFIG_TSDIN;
+
+	if (device_property_read_bool(dev, "adi,ts-power-switch"))
+		cfg |= MAX31335_TIMESTAMP_CONFIG_TSPWM;
+
+	if (device_property_read_bool(dev, "adi,ts-vbat-low"))
+		cfg |= MAX31335_TIMESTAMP_CONFIG_TSVLOW;
+
+	if (!cfg)
+		return 0;
+
+	cfg |= MAX31335_TIMESTAMP_CONFIG_TSE;
+
+	if (device_property_read_bool(dev, "adi,ts-overwrite"))
+		cfg |= MAX31335_TIMESTAMP_CONFIG_TSOW;
+
+	return cfg;
+}
+
+static unsigned int max31335_temp_config(struct device *dev,
+					 unsigned int ts_config)
+{
+	unsigned int tsint = FIELD_GET(MAX31335_TS_CONFIG_TSINT, ts_config);
+	u32 interval;
+	int i;
+
+	if (device_property_read_u32(dev, "adi,temp-conversion-interval-ms",
+				     &interval))
+		return tsint;
+
+	for (i = 0; i < ARRAY_SIZE(max31335_temp_interval); i++)
+		if (interval == max31335_temp_interval[i])
+			return i;
+
+	dev_warn(dev, "invalid temperature conversion interval\n");
+
+	return tsint;
+}
+
+/*
+ * Bring up the secondary functions configured from DT: clock output,
+ * trickle charger, power fail threshold, timestamp capture, automatic
+ * temperature conversion and the interrupt enables. Register values are
+ * computed up front and written with a single regmap_multi_reg_write()
+ * sequence rather than a read-modify-write per feature. This runs after
+ * the RTC is registered, so the interrupt enables are updated separately
+ * and only for the bits owned here.
+ *
+ * The temperature sensor is put in automatic conversion mode so TEMP_DATA
+ * is always fresh. With an interrupt line, TEMP_RDY refreshes a cached
+ * reading after every conversion and OTF/UTF report crossings of the
+ * temperature limits.
+ */
+static int max31335_hw_init(struct device *dev, struct max31335_data *max31335,
+			    bool irq)
+{
+	struct reg_sequence seq[5];
+	unsigned int int_en1 = 0, ts_config, reg, mask;
+	int n = 0, ret;
+
+	if (irq)
+		int_en1 |= MAX31335_INT_EN1_PFAILE | MAX31335_INT_EN1_VBATLOWE;
+
+	if (max31335->chip->temp) {
+		ret = regmap_read(max31335->regmap, MAX31335_TS_CONFIG,
+				  &ts_config);
+		if (ret)
+			return ret;
+
+		max31335->temp_tsint = max31335_temp_config(dev, ts_config);
+		seq[n++] = (struct reg_sequence) {
+			MAX31335_TS_CONFIG,
+			FIELD_PREP(MAX31335_TS_CONFIG_TSINT,
+				   max31335->temp_tsint) |
+			MAX31335_TS_CONFIG_AUTO
+		};
+	}
+
+	/* existing captures are kept, they are cleared through timestamps */
+	reg = max31335->chip->ts ? max31335_timestamp_config(dev) : 0;
+	if (reg) {
+		seq[n++] = (struct reg_sequence) {
+			max31335->chip->timestamp_config, reg
+		};
+
+		if (reg & MAX31335_TIMESTAMP_CONFIG_TSDIN)
+			int_en1 |= MAX31335_INT_EN1_DIE;
+	}
+
+	/* without a DT setting the charger is left as found */
+	ret = max31335_trickle_charger_config(dev, &reg);
+	if (!ret) {
+		seq[n++] = (struct reg_sequence) {
+			max31335->chip->trickle, reg
+		};
+	} else if (ret == -ENOENT) {
+		ret = regmap_read(max31335->regmap, max31335->chip->trickle,
+				  &reg);
+		if (ret)
+			return ret;
+	} else {
+		return ret;
+	}
+
+	max31335->trickle_reg = reg;
+
+	/* only the threshold is owned here, the other bits are kept */
+	ret = regmap_read(max31335->regmap, max31335->chip->pwr_mgmt, &reg);
+	if (ret)
+		return ret;
+
+	reg &= ~MAX31335_PWR_MGMT_PFVT;
+	if (device_property_read_bool(dev, "adi,power-fail-threshold-high"))
+		reg |= MAX31335_PWR_MGMT_PFVT;
+
+	seq[n++] = (struct reg_sequence) { max31335->chip->pwr_mgmt, reg };
+
+	if (device_property_present(dev, "#clock-cells")) {
+		ret = max31335_clkout_config(dev, max31335, &reg);
+		if (ret)
+			return ret;
+
+		seq[n++] = (struct reg_sequence) {
+			max31335->chip->rtc_config2, reg
+		};
+	}
+
+	ret = regmap_multi_reg_write(max31335->regmap, seq, n);
+	if (ret)
+		return ret;
+
+	if (max31335->chip->temp) {
+		mask = MAX31335_INT_EN2_TEMP_RDY_EN | MAX31335_INT_EN2_OTIE |
+		       MAX31335_INT_EN2_UTIE;
+		ret = regmap_update_bits(max31335->regmap, MAX31335_INT_EN2,
+					 mask, irq ? mask : 0);
+		if (ret)
+			return ret;
+	}
+
+	/*
+	 * A1IE belongs to the RTC core. Timer and Alarm2 enables left over
+	 * from a previous boot are dropped, unless they were armed since the
+	 * RTC was registered.
+	 */
+	mask = MAX31335_INT_EN1_DOSF | MAX31335_INT_EN1_PFAILE |
+	       MAX31335_INT_EN1_VBATLOWE | MAX31335_INT_EN1_DIE;
+
+	mutex_lock(&max31335->timer_lock);
+	mutex_lock(&max31335->alarm2_lock);
+	if (!max31335->timer_ms)
+		mask |= MAX31335_INT_EN1_TIE;
+	if (!max31335->alarm2_time)
+		mask |= MAX31335_INT_EN1_A2IE;
+	ret = regmap_update_bits(max31335->regmap, MAX31335_INT_EN1, mask,
+				 int_en1);
+	mutex_unlock(&max31335->alarm2_lock);
+	mutex_unlock(&max31335->timer_lock);
+	if (ret)
+		return ret;
+
+	max31335->temp_irq = irq && max31335->chip->temp;
+
+	return 0;
+}
+
+/*
+ * RTC_CONFIG2 is not volatile, so the rate and gate state come from the
+ * register cache and clock tree walks cause no bus traffic. The rate only
+ * changes through set_rate, so CLK_GET_RATE_NOCACHE is not needed either.
+ */
+static unsigned long max31335_clkout_recalc_rate(struct clk_hw *hw,
+						 unsigned long parent_rate)
+{
+	struct max31335_data *max31335 = clk_hw_to_max31335(hw);
+	unsigned int reg;
+	int ret;
+
+	ret = regmap_read(max31335->regmap, max31335->chip->rtc_config2, &reg);
+	if (ret)
+		return 0;
+
+	return max31335_clkout_freq[FIELD_GET(MAX31335_RTC_CONFIG2_CLKO_HZ, reg)];
+}
+
+static int max31335_clkout_determine_rate(struct clk_hw *hw,
+					  struct clk_rate_request *req)
+{
+	int index;
+
+	index = find_closest(req->rate, max31335_clkout_freq,
+			     ARRAY_SIZE(max31335_clkout_freq));
+
+	req->rate = max31335_clkout_freq[index];
+
+	return 0;
+}
+
+static int max31335_clkout_set_rate(struct clk_hw *hw, unsigned long rate,
+				    unsigned long parent_rate)
+{
+	struct max31335_data *max31335 = clk_hw_to_max31335(hw);
+	int index;
+
+	index = find_closest(rate, max31335_clkout_freq,
+			     ARRAY_SIZE(max31335_clkout_freq));
+
+	return regmap_update_bits(max31335->regmap, max31335->chip->rtc_config2,
+				  MAX31335_RTC_CONFIG2_CLKO_HZ,
+				  FIELD_PREP(MAX31335_RTC_CONFIG2_CLKO_HZ, index));
+}
+
+static int max31335_clkout_enable(struct clk_hw *hw)
+{
+	struct max31335_data *max31335 = clk_hw_to_max31335(hw);
+
+	return regmap_set_bits(max31335->regmap, max31335->chip->rtc_config2,
+			       MAX31335_RTC_CONFIG2_ENCLKO);
+}
+
+static void max31335_clkout_disable(struct clk_hw *hw)
+{
+	struct max31335_data *max31335 = clk_hw_to_max31335(hw);
+
+	regmap_clear_bits(max31335->regmap, max31335->chip->rtc_config2,
+			  MAX31335_RTC_CONFIG2_ENCLKO);
+}
+
+static int max31335_clkout_is_enabled(struct clk_hw *hw)
+{
+	struct max31335_data *max31335 = clk_hw_to_max31335(hw);
+	unsigned int reg;
+	int ret;
+
+	ret = regmap_read(max31335->regmap, max31335->chip->rtc_config2, &reg);
+	if (ret)
+		return ret;
+
+	return !!(reg & MAX31335_RTC_CONFIG2_ENCLKO);
+}
+
+static const struct clk_ops max31335_clkout_ops = {
+	.recalc_rate = max31335_clkout_recalc_rate,
+	.determine_rate = max31335_clkout_determine_rate,
+	.set_rate = max31335_clkout_set_rate,
+	.enable = max31335_clkout_enable,
+	.disable = max31335_clkout_disable,
+	.is_enabled = max31335_clkout_is_enabled,
+};
+
+/*
+ * The battery-backed RAM is never modified by the device, so it is loaded
+ * once with a single burst and kept in a shadow copy. Reads are served from
+ * the shadow and writes only send the span of bytes that actually changed.
+ */
+static int max31335_nvmem_load(struct max31335_data *max31335)
+{
+	int ret;
+
+	if (max31335->ram_valid)
+		return 0;
+
+	ret = regmap_bulk_read(max31335->regmap, max31335->chip->ram,
+			       max31335->ram, max31335->chip->ram_size);
+	if (ret)
+		return ret;
+
+	max31335->ram_valid = true;
+
+	return 0;
+}
+
+static int __max31335_nvmem_reg_read(struct max31335_data *max31335,
+				     unsigned int offset, void *val,
+				     size_t bytes)
+{
+	int ret;
+
+	mutex_lock(&max31335->ram_lock);
+
+	ret = max31335_nvmem_load(max31335);
+	if (!ret)
+		memcpy(val, &max31335->ram[offset], bytes);
+
+	mutex_unlock(&max31335->ram_lock);
+
+	return ret;
+}
+
+static int max31335_nvmem_reg_read(void *priv, unsigned int offset,
+				   void *val, size_t bytes)
+{
+	struct max31335_data *max31335 = priv;
+
+	return max31335_op(max31335, MAX31335_OP_NVMEM_READ,
+			   __max31335_nvmem_reg_read(max31335, offset, val,
+						     bytes));
+}
+
+static int __max31335_nvmem_reg_write(struct max31335_data *max31335,
+				      unsigned int offset, void *val,
+				      size_t bytes)
+{
+	unsigned int first, last;
+	u8 *buf = val;
+	int ret;
+
+	mutex_lock(&max31335->ram_lock);
+
+	ret = max31335_nvmem_load(max31335);
+	if (ret)
+		goto unlock;
+
+	for (first = 0; first < bytes; first++)
+		if (buf[first] != max31335->ram[offset + first])
+			break;
+
+	if (first == bytes)
+		goto unlock;
+
+	for (last = bytes - 1; last > first; last--)
+		if (buf[last] != max31335->ram[offset + last])
+			break;
+
+	ret = regmap_bulk_write(max31335->regmap,
+				max31335->chip->ram + offset + first,
+				&buf[first], last - first + 1);
+	if (ret)
+		goto unlock;
+
+	memcpy(&max31335->ram[offset + first], &buf[first], last - first + 1);
+
+unlock:
+	mutex_unlock(&max31335->ram_lock);
+
+	return ret;
+}
+
+static int max31335_nvmem_reg_write(void *priv, unsigned int offset,
+				    void *val, size_t bytes)
+{
+	struct max31335_data *max31335 = priv;
+
+	return max31335_op(max31335, MAX31335_OP_NVMEM_WRITE,
+			   __max31335_nvmem_reg_write(max31335, offset, val,
+						      bytes));
+}
+
+static int max31335_temp_limit_reg(u32 attr)
+{
+	return attr == hwmon_temp_max ? MAX31335_TEMP_ALARM_HIGH_MSB :
+					MAX31335_TEMP_ALARM_LOW_MSB;
+}
+
+static int __max31335_read_temp(struct max31335_data *max31335,
+				enum hwmon_sensor_types type, u32 attr,
+				long *val)
+{
+	u8 reg[2];
+	int ret;
+
+	if (type == hwmon_chip && attr == hwmon_chip_update_interval) {
+		*val = max31335_temp_interval[max31335->temp_tsint];
+		return 0;
+	}
+
+	if (type != hwmon_temp)
+		return -EOPNOTSUPP;
+
+	switch (attr) {
+	case hwmon_temp_input:
+		/* refreshed by the TEMP_RDY interrupt after every conversion */
+		if (max31335->temp_irq && READ_ONCE(max31335->temp_valid)) {
+			*val = READ_ONCE(max31335->temp);
+			return 0;
+		}
+
+		return max31335_temp_fetch(max31335, val);
+	case hwmon_temp_max:
+	case hwmon_temp_min:
+		/* limits are not volatile and come from the register cache */
+		ret = regmap_bulk_read(max31335->regmap,
+				       max31335_temp_limit_reg(attr), reg, 2);
+		if (ret)
+			return ret;
+
+		*val = ((s16)get_unaligned_be16(reg) / 64) * 250;
+		return 0;
+	case hwmon_temp_max_alarm:
+	case hwmon_temp_min_alarm:
+		/* latched by the OTF/UTF interrupt, cleared when read */
+		*val = test_and_clear_bit(attr, &max31335->temp_alarms);
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static int max31335_read_temp(struct device *dev, enum hwmon_sensor_types type,
+			      u32 attr, int channel, long *val)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+
+	return max31335_op(max31335, MAX31335_OP_HWMON_READ,
+			   __max31335_read_temp(max31335, type, attr, val));
+}
+
+static int max31335_write_temp(struct device *dev, enum hwmon_sensor_types type,
+			       u32 attr, int channel, long val)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+	int index, ret;
+	u8 reg[2];
+
+	if (type == hwmon_temp &&
+	    (attr == hwmon_temp_max || attr == hwmon_temp_min)) {
+		val = clamp_val(DIV_ROUND_CLOSEST(val, 250), -512, 511);
+		put_unaligned_be16(val * 64, reg);
+
+		return regmap_bulk_write(max31335->regmap,
+					 max31335_temp_limit_reg(attr), reg, 2);
+	}
+
+	if (type != hwmon_chip || attr != hwmon_chip_update_interval)
+		return -EOPNOTSUPP;
+
+	index = find_closest(val, max31335_temp_interval,
+			     ARRAY_SIZE(max31335_temp_interval));
+
+	ret = regmap_update_bits(max31335->regmap, MAX31335_TS_CONFIG,
+				 MAX31335_TS_CONFIG_TSINT,
+				 FIELD_PREP(MAX31335_TS_CONFIG_TSINT, index));
+	if (ret)
+		return ret;
+
+	max31335->temp_tsint = index;
+
+	return 0;
+}
 
 static umode_t max31335_is_visible(const void *data,
 				   enum hwmon_sensor_types type,
 				   u32 attr, int channel)
 {
-	if (type == hwmon_temp && attr == hwmon_temp_input)
-		return 0444;
+	const struct max31335_data *max31335 = data;
+
+	if (type == hwmon_chip && attr == hwmon_chip_update_interval)
+		return 0644;
+
+	if (type != hwmon_temp)
+		return 0;
+
+	switch (attr) {
+	case hwmon_temp_input:
+		return 0444;
+	case hwmon_temp_max:
+	case hwmon_temp_min:
+		return 0644;
+	case hwmon_temp_max_alarm:
+	case hwmon_temp_min_alarm:
+		return max31335->temp_irq ? 0444 : 0;
+	default:
+		return 0;
+	}
+}
+
+static const struct hwmon_channel_info *max31335_info[] = {
+	HWMON_CHANNEL_INFO(chip, HWMON_C_UPDATE_INTERVAL),
+	HWMON_CHANNEL_INFO(temp, HWMON_T_INPUT | HWMON_T_MAX | HWMON_T_MIN |
+			   HWMON_T_MAX_ALARM | HWMON_T_MIN_ALARM),
+	NULL
+};
+
+static const struct hwmon_ops max31335_hwmon_ops = {
+	.is_visible = max31335_is_visible,
+	.read = max31335_read_temp,
+	.write = max31335_write_temp,
+};
+
+static const struct hwmon_chip_info max31335_hwmon_chip_info = {
+	.ops = &max31335_hwmon_ops,
+	.info = max31335_info,
+};
+
+static int max31335_clkout_register(struct device *dev)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+	struct clk_init_data init = {
+		.ops = &max31335_clkout_ops,
+	};
+	int ret;
+
+	if (!device_property_present(dev, "#clock-cells"))
+		return 0;
+
+	/* clock names are global, make them unique per instance */
+	if (device_property_read_string(dev, "clock-output-names", &init.name)) {
+		init.name = devm_kasprintf(dev, GFP_KERNEL, "%s-clkout",
+					   dev_name(dev));
+		if (!init.name)
+			return -ENOMEM;
+	}
+
+	/* the clk core copies the init data during registration */
+	max31335->clkout.init = &init;
+
+	ret = devm_clk_hw_register(dev, &max31335->clkout);
+	if (ret)
+		return dev_err_probe(dev, ret, "cannot register clock\n");
+
+	ret = devm_of_clk_add_hw_provider(dev, of_clk_hw_simple_get,
+					  &max31335->clkout);
+	if (ret)
+		return dev_err_probe(dev, ret, "cannot add hw provider\n");
+
+	return 0;
+}
+
+static void max31335_events_free(struct kref *ref)
+{
+	kfree(container_of(ref, struct max31335_events, ref));
+}
+
+static bool max31335_event_ready(struct max31335_events *evs)
+{
+	return !kfifo_is_empty(&evs->fifo) ||
+	       atomic_read(&evs->merged_count) || READ_ONCE(evs->gone);
+}
+
+/* take the next record, or turn merged interrupts into one once drained */
+static bool max31335_event_pop(struct max31335_events *evs,
+			       struct max31335_event *ev)
+{
+	if (kfifo_get(&evs->fifo, ev))
+		return true;
+
+	ev->count = atomic_xchg(&evs->merged_count, 0);
+	if (!ev->count)
+		return false;
+
+	ev->events = atomic_xchg(&evs->merged, 0);
+	ev->time_ns = atomic64_read(&evs->merged_ns);
+
+	return true;
+}
+
+/* misc_open() calls this under misc_mtx, so it cannot race with removal */
+static int max31335_events_open(struct inode *inode, struct file *file)
+{
+	struct max31335_events *evs = container_of(file->private_data,
+						   struct max31335_events,
+						   misc);
+
+	kref_get(&evs->ref);
+	file->private_data = evs;
 
 	return 0;
 }
 
-static const struct hwmon_channel_info *max31335_info[] = {
-	HWMON_CHANNEL_INFO(temp, HWMON_T_INPUT),
-	NULL
-};
+static int max31335_events_release(struct inode *inode, struct file *file)
+{
+	struct max31335_events *evs = file->private_data;
 
-static const struct hwmon_ops max31335_hwmon_ops = {
-	.is_visible = max31335_is_visible,
-	.read = max31335_read_temp,
-};
+	kref_put(&evs->ref, max31335_events_free);
 
-static const struct hwmon_chip_info max31335_chip_info = {
-	.ops = &max31335_hwmon_ops,
-	.info = max31335_info,
+	return 0;
+}
+
+static ssize_t max31335_events_read(struct file *file, char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	struct max31335_events *evs = file->private_data;
+	struct max31335_event ev;
+	size_t done;
+	int ret;
+
+	if (count < sizeof(ev))
+		return -EINVAL;
+
+	for (;;) {
+		ret = mutex_lock_interruptible(&evs->lock);
+		if (ret)
+			return ret;
+
+		for (done = 0; done + sizeof(ev) <= count; done += sizeof(ev)) {
+			if (!max31335_event_pop(evs, &ev))
+				break;
+
+			if (copy_to_user(buf + done, &ev, sizeof(ev))) {
+				ret = -EFAULT;
+				break;
+			}
+		}
+
+		mutex_unlock(&evs->lock);
+
+		if (done)
+			return done;
+		if (ret)
+			return ret;
+		if (READ_ONCE(evs->gone))
+			return -ENODEV;
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(evs->wait,
+					       max31335_event_ready(evs));
+		if (ret)
+			return ret;
+	}
+}
+
+static __poll_t max31335_events_poll(struct file *file, poll_table *wait)
+{
+	struct max31335_events *evs = file->private_data;
+	__poll_t mask = 0;
+
+	poll_wait(file, &evs->wait, wait);
+
+	if (!kfifo_is_empty(&evs->fifo) || atomic_read(&evs->merged_count))
+		mask |= EPOLLIN | EPOLLRDNORM;
+	if (READ_ONCE(evs->gone))
+		mask |= EPOLLHUP | EPOLLERR;
+
+	return mask;
+}
+
+static const struct file_operations max31335_events_fops = {
+	.owner = THIS_MODULE,
+	.open = max31335_events_open,
+	.release = max31335_events_release,
+	.read = max31335_events_read,
+	.poll = max31335_events_poll,
+	.llseek = noop_llseek,
 };
 
-static int max31335_clkout_register(struct device *dev)
+static void max31335_events_put(void *data)
+{
+	struct max31335_events *evs = data;
+
+	kref_put(&evs->ref, max31335_events_free);
+}
+
+/*
+ * Allocated before the interrupt is requested, so the driver reference is
+ * only dropped once the IRQ thread can no longer push records.
+ */
+static int max31335_events_alloc(struct device *dev)
 {
 	struct max31335_data *max31335 = dev_get_drvdata(dev);
+	struct max31335_events *evs;
+
+	evs = kzalloc(sizeof(*evs), GFP_KERNEL);
+	if (!evs)
+		return -ENOMEM;
+
+	kref_init(&evs->ref);
+	mutex_init(&evs->lock);
+	init_waitqueue_head(&evs->wait);
+	INIT_KFIFO(evs->fifo);
+	max31335->events = evs;
+
+	return devm_add_action_or_reset(dev, max31335_events_put, evs);
+}
+
+/* no new opens after misc_deregister(), open files see the device gone */
+static void max31335_events_remove(void *data)
+{
+	struct max31335_events *evs = data;
+
+	misc_deregister(&evs->misc);
+	WRITE_ONCE(evs->gone, true);
+	wake_up_interruptible_poll(&evs->wait, EPOLLHUP | EPOLLERR);
+}
+
+/* one character device per RTC, /dev/rtcN-events, for all decoded events */
+static int max31335_events_register(struct device *dev)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+	struct miscdevice *misc = &max31335->events->misc;
 	int ret;
 
-	if (!device_property_present(dev, "#clock-cells"))
+	misc->minor = MISC_DYNAMIC_MINOR;
+	misc->fops = &max31335_events_fops;
+	misc->parent = dev;
+	misc->name = devm_kasprintf(dev, GFP_KERNEL, "%s-events",
+				    dev_name(&max31335->rtc->dev));
+	if (!misc->name)
+		return -ENOMEM;
+
+	ret = misc_register(misc);
+	if (ret)
+		return ret;
+
+	return devm_add_action_or_reset(dev, max31335_events_remove,
+					max31335->events);
+}
+
+static int max31335_stats_show(struct seq_file *s, void *data)
+{
+	struct max31335_data *max31335 = s->private;
+	struct max31335_op_stats stats[MAX31335_OP_NUM], irq_latency;
+	s64 xfers_base, bytes_base;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&max31335->stats_lock, flags);
+	memcpy(stats, max31335->stats, sizeof(stats));
+	irq_latency = max31335->irq_latency;
+	xfers_base = max31335->bus_xfers_base;
+	bytes_base = max31335->bus_bytes_base;
+	spin_unlock_irqrestore(&max31335->stats_lock, flags);
+
+	seq_printf(s, "%-12s %10s %8s %10s %10s %12s %12s %10s %10s %5s\n",
+		   "op", "calls", "errors", "xfers", "bytes", "total_ns",
+		   "avg_ns", "max_ns", "hits", "hit%");
+
+	for (i = 0; i < MAX31335_OP_NUM; i++)
+		seq_printf(s, "%-12s %10llu %8llu %10llu %10llu %12llu %12llu %10llu %10llu %5llu\n",
+			   max31335_op_names[i], stats[i].calls,
+			   stats[i].errors, stats[i].xfers, stats[i].bytes,
+			   stats[i].total_ns,
+			   stats[i].calls ?
+			   div64_u64(stats[i].total_ns, stats[i].calls) : 0,
+			   stats[i].max_ns, stats[i].hits,
+			   stats[i].calls ?
+			   div64_u64(stats[i].hits * 100, stats[i].calls) : 0);
+
+	seq_printf(s, "\nbus_xfers %lld\nbus_bytes %lld\n",
+		   atomic64_read(&max31335->bus_xfers) - xfers_base,
+		   atomic64_read(&max31335->bus_bytes) - bytes_base);
+
+	seq_printf(s, "irq_to_update count %llu total_ns %llu avg_ns %llu max_ns %llu\n",
+		   irq_latency.calls, irq_latency.total_ns,
+		   irq_latency.calls ?
+		   div64_u64(irq_latency.total_ns, irq_latency.calls) : 0,
+		   irq_latency.max_ns);
+
+	seq_printf(s, "events_dropped %d\n", max31335->events ?
+		   atomic_read(&max31335->events->dropped) : 0);
+
+	return 0;
+}
+
+static int max31335_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, max31335_stats_show, inode->i_private);
+}
+
+/* any write clears the counters, so runs can be measured in isolation */
+static ssize_t max31335_stats_write(struct file *file, const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct max31335_data *max31335 = s->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&max31335->stats_lock, flags);
+	memset(max31335->stats, 0, sizeof(max31335->stats));
+	memset(&max31335->irq_latency, 0, sizeof(max31335->irq_latency));
+	/*
+	 * The bus counters keep running: operations in flight take their
+	 * deltas from them, so a reset only moves the reporting base.
+	 */
+	max31335->bus_xfers_base = atomic64_read(&max31335->bus_xfers);
+	max31335->bus_bytes_base = atomic64_read(&max31335->bus_bytes);
+	spin_unlock_irqrestore(&max31335->stats_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations max31335_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = max31335_stats_open,
+	.read = seq_read,
+	.write = max31335_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int max31335_cache_bypass_get(void *data, u64 *val)
+{
+	struct max31335_data *max31335 = data;
+
+	*val = READ_ONCE(max31335->cache_bypass);
+
+	return 0;
+}
+
+/*
+ * Registers written while the cache is bypassed leave it stale, so it is
+ * dropped when the bypass ends and refilled from the device on demand.
+ */
+static int max31335_cache_bypass_set(void *data, u64 val)
+{
+	struct max31335_data *max31335 = data;
+	unsigned int max = max31335->chip->regmap_config->max_register;
+	bool bypass = !!val;
+
+	if (bypass == max31335->cache_bypass)
 		return 0;
 
-	max31335->clkout.init = &max31335_clk_init;
+	regcache_cache_bypass(max31335->regmap, bypass);
+	WRITE_ONCE(max31335->cache_bypass, bypass);
 
-	ret = devm_clk_hw_register(dev, &max31335->clkout);
+	if (bypass)
+		return 0;
+
+	return regcache_drop_region(max31335->regmap, 0, max);
+}
+DEFINE_DEBUGFS_ATTRIBUTE(max31335_cache_bypass_fops, max31335_cache_bypass_get,
+			 max31335_cache_bypass_set, "%llu\n");
+
+static void max31335_work_cancel(void *data)
+{
+	struct max31335_data *max31335 = data;
+
+	cancel_work_sync(&max31335->aging_work);
+	cancel_work_sync(&max31335->alarm2_work);
+}
+
+static void max31335_debugfs_remove(void *data)
+{
+	debugfs_remove_recursive(data);
+}
+
+static int max31335_debugfs_init(struct device *dev)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+	struct dentry *dir;
+	char name[32];
+
+	snprintf(name, sizeof(name), "max31335-%s", dev_name(dev));
+	dir = debugfs_create_dir(name, NULL);
+	debugfs_create_file("stats", 0644, dir, max31335, &max31335_stats_fops);
+	debugfs_create_file_unsafe("cache_bypass", 0644, dir, max31335,
+				   &max31335_cache_bypass_fops);
+	debugfs_create_bool("single_xfer", 0644, dir, &max31335->single_xfer);
+	debugfs_create_u32("xfer_delay_us", 0644, dir, &max31335->xfer_delay_us);
+
+	if (max31335->emul)
+		max31335_emul_debugfs_init(max31335->emul, dir);
+
+	return devm_add_action_or_reset(dev, max31335_debugfs_remove, dir);
+}
+
+/*
+ * Switch the device to 24-hour mode once, so the time keeping path never
+ * has to handle the 12-hour format, and prime the cached century.
+ */
+static int max31335_time_init(struct max31335_data *max31335)
+{
+	u8 date[MAX31335_TIME_SIZE];
+	unsigned int hour;
+	int ret;
+
+	ret = regmap_bulk_read(max31335->regmap, max31335->chip->time + 1, date,
+			       sizeof(date));
 	if (ret)
-		return dev_err_probe(dev, ret, "cannot register clock\n");
+		return ret;
 
-	ret = devm_of_clk_add_hw_provider(dev, of_clk_hw_simple_get,
-					  &max31335->clkout);
+	max31335->century = FIELD_GET(MAX31335_MONTH_CENTURY, date[5]);
+
+	if (!FIELD_GET(MAX31335_HOURS_F_24_12, date[2]))
+		return 0;
+
+	hour = bcd2bin(date[2] & 0x1f) % 12;
+	if (FIELD_GET(MAX31335_HOURS_HR_20_AM_PM, date[2]))
+		hour += 12;
+
+	return regmap_write(max31335->regmap,
+			    max31335->chip->time + MAX31335_TIME_HOURS,
+			    bin2bcd(hour));
+}
+
+static int max31335_reset(struct max31335_data *max31335)
+{
+	int ret;
+
+	ret = regmap_write(max31335->regmap, max31335->chip->rtc_reset,
+			   MAX31335_RTC_RESET_SWRST);
 	if (ret)
-		return dev_err_probe(dev, ret, "cannot add hw provider\n");
+		return ret;
 
-	ret = clk_prepare_enable(max31335->clkout.clk);
+	ret = regmap_write(max31335->regmap, max31335->chip->rtc_reset, 0);
 	if (ret)
-		return dev_err_probe(dev, ret, "cannot enable clkout\n");
+		return ret;
+
+	/* only called from probe, before anything has been cached */
+	max31335->time_invalid = true;
 
 	return 0;
 }
@@ -637,6 +3621,16 @@ static int max31335_clkout_register(struct device *dev)
 static int max31335_probe(struct i2c_client *client,
 			  const struct i2c_device_id *id)
 {
+	struct nvmem_config nvmem_cfg = {
+		.name = "max31335_nvram",
+		.id = NVMEM_DEVID_AUTO,
+		.type = NVMEM_TYPE_BATTERY_BACKED,
+		.reg_read = max31335_nvmem_reg_read,
+		.reg_write = max31335_nvmem_reg_write,
+		.word_size = 1,
+		.stride = 1,
+	};
+	const struct max31335_chip_info *chip;
 	struct max31335_data *max31335;
 	struct device *hwmon;
 	int ret, status;
@@ -646,48 +3640,94 @@ static int max31335_probe(struct i2c_client *client,
 	if (!max31335)
 		return -ENOMEM;
 
-	max31335->regmap = devm_regmap_init_i2c(client, &regmap_config);
+	chip = device_get_match_data(&client->dev);
+	if (!chip)
+		chip = (const struct max31335_chip_info *)id->driver_data;
+	if (!chip)
+		return -ENODEV;
+
+	nvmem_cfg.priv = max31335;
+	nvmem_cfg.size = chip->ram_size;
+	max31335->chip = chip;
+	max31335->client = client;
+	spin_lock_init(&max31335->stats_lock);
+
+	if (max31335_emul_wanted(client, id)) {
+		ret = max31335_emul_init(&client->dev, max31335);
+		if (ret)
+			return ret;
+	}
+
+	if (max31335->emul ||
+	    i2c_check_functionality(client->adapter, I2C_FUNC_I2C))
+		max31335->regmap = devm_regmap_init(&client->dev,
+						    &max31335_regmap_bus,
+						    max31335,
+						    chip->regmap_config);
+	else
+		max31335->regmap = devm_regmap_init_i2c(client,
+							chip->regmap_config);
 	if (IS_ERR(max31335->regmap))
 		return PTR_ERR(max31335->regmap);
 
 	i2c_set_clientdata(client, max31335);
-
-	ret = regmap_write(max31335->regmap, MAX31335_RTC_RESET, 1);
-	if (ret)
-		return ret;
-
-	ret = regmap_write(max31335->regmap, MAX31335_RTC_RESET, 0);
+	mutex_init(&max31335->ram_lock);
+	mutex_init(&max31335->aging_lock);
+	mutex_init(&max31335->timer_lock);
+	mutex_init(&max31335->alarm2_lock);
+	mutex_init(&max31335->trickle_lock);
+	INIT_WORK(&max31335->aging_work, max31335_aging_work);
+	INIT_WORK(&max31335->alarm2_work, max31335_alarm2_work);
+
+	/* registered before the IRQ, so it runs once the handler is gone */
+	ret = devm_add_action_or_reset(&client->dev, max31335_work_cancel,
+				       max31335);
 	if (ret)
 		return ret;
 
+	/*
+	 * A software reset wipes the running configuration, so it is only
+	 * issued when the oscillator stopped and the time is lost anyway, or
+	 * when the board asks for it.
+	 */
 	ret = regmap_read(max31335->regmap, MAX31335_STATUS1, &status);
-	if (ret)
+	if (ret) {
+		dev_err(&client->dev, "Unable to read from device.\n");
 		return ret;
+	}
 
-	if (status != MAX31335_STATUS1_DEFAULT) {
-		dev_err(&client->dev, "Unable to read from device.\n");
-		return -EINVAL;
+	if (status & MAX31335_STATUS1_OSF ||
+	    device_property_read_bool(&client->dev, "adi,reset-on-probe")) {
+		ret = max31335_reset(max31335);
+		if (ret)
+			return ret;
 	}
 
+	ret = max31335_time_init(max31335);
+	if (ret)
+		return ret;
+
 	max31335->rtc = devm_rtc_allocate_device(&client->dev);
 	if (IS_ERR(max31335->rtc))
 		return PTR_ERR(max31335->rtc);
 
 	max31335->rtc->ops = &max31335_rtc_ops;
+	max31335->set_offset_nsec = max31335->rtc->set_offset_nsec;
 	max31335->rtc->range_min = RTC_TIMESTAMP_BEGIN_2000;
 	max31335->rtc->range_max = RTC_TIMESTAMP_END_2199;
 
-	ret = devm_rtc_register_device(max31335->rtc);
-	if (ret)
-		return ret;
-
-	ret = max31335_clkout_register(&client->dev);
+	ret = rtc_add_group(max31335->rtc, &max31335_attr_group);
 	if (ret)
 		return ret;
 
 	if (client->irq > 0) {
+		ret = max31335_events_alloc(&client->dev);
+		if (ret)
+			return ret;
+
 		ret = devm_request_threaded_irq(&client->dev, client->irq,
-						NULL, max31335_handle_irq,
+						max31335_irq_stamp,
+						max31335_handle_irq,
 						IRQF_ONESHOT,
 						"max31335", max31335);
 		if (ret) {
@@ -697,31 +3737,203 @@ static int max31335_probe(struct i2c_client *client,
 		}
 	}
 
-	if (!client->irq)
+	/*
+	 * With wakeup-source and no interrupt, INT is wired to a power
+	 * controller only: alarms can still be set and wake the system, but
+	 * nothing is reported back to the driver.
+	 */
+	if (client->irq) {
+		device_init_wakeup(&client->dev, true);
+	} else if (device_property_read_bool(&client->dev, "wakeup-source")) {
+		device_init_wakeup(&client->dev, true);
+		set_bit(RTC_FEATURE_ALARM_WAKEUP_ONLY, max31335->rtc->features);
+		clear_bit(RTC_FEATURE_UPDATE_INTERRUPT, max31335->rtc->features);
+	} else {
 		clear_bit(RTC_FEATURE_ALARM, max31335->rtc->features);
+	}
+
+	/* the time keeping path is usable from here on */
+	ret = devm_rtc_register_device(max31335->rtc);
+	if (ret)
+		return ret;
+
+	ret = max31335_hw_init(&client->dev, max31335, client->irq > 0);
+	if (ret)
+		return ret;
+
+	ret = max31335_clkout_register(&client->dev);
+	if (ret)
+		return ret;
+
+	ret = devm_rtc_nvmem_register(max31335->rtc, &nvmem_cfg);
+	if (ret)
+		return ret;
+
+	if (client->irq) {
+		ret = max31335_events_register(&client->dev);
+		if (ret)
+			return ret;
+	}
 
-	max31335_nvmem_cfg.priv = max31335;
+	if (!chip->temp)
+		return max31335_debugfs_init(&client->dev);
 
 	hwmon = devm_hwmon_device_register_with_info(&client->dev, client->name,
 						     max31335,
-						     &max31335_chip_info,
+						     &max31335_hwmon_chip_info,
 						     NULL);
 	if (IS_ERR(hwmon))
 		dev_warn(&client->dev, "cannot register hwmon device: %li\n",
 			 PTR_ERR(hwmon));
+	else
+		max31335->hwmon = hwmon;
+
+	return max31335_debugfs_init(&client->dev);
+}
+
+/*
+ * Sources that are not meant to wake the system. Their enables are saved
+ * and cleared on suspend and put back on resume.
+ */
+#define MAX31335_INT_EN1_NOWAKE	(MAX31335_INT_EN1_PFAILE | \
+				 MAX31335_INT_EN1_VBATLOWE | \
+				 MAX31335_INT_EN1_DIE)
+#define MAX31335_INT_EN2_NOWAKE	(MAX31335_INT_EN2_TEMP_RDY_EN | \
+				 MAX31335_INT_EN2_OTIE | \
+				 MAX31335_INT_EN2_UTIE)
+
+static int max31335_irq_restore(struct max31335_data *max31335)
+{
+	int ret;
+
+	ret = regmap_set_bits(max31335->regmap, MAX31335_INT_EN1,
+			      max31335->suspend_int_en1);
+	if (ret)
+		return ret;
+
+	if (!max31335->chip->temp)
+		return 0;
+
+	return regmap_set_bits(max31335->regmap, MAX31335_INT_EN2,
+			       max31335->suspend_int_en2);
+}
+
+static int max31335_irq_suspend(struct max31335_data *max31335)
+{
+	unsigned int int_en1, int_en2 = 0;
+	int ret;
+
+	/* both are cached, this causes no bus traffic */
+	ret = regmap_read(max31335->regmap, MAX31335_INT_EN1, &int_en1);
+	if (ret)
+		return ret;
+
+	if (max31335->chip->temp) {
+		ret = regmap_read(max31335->regmap, MAX31335_INT_EN2, &int_en2);
+		if (ret)
+			return ret;
+	}
+
+	max31335->suspend_int_en1 = int_en1 & MAX31335_INT_EN1_NOWAKE;
+	max31335->suspend_int_en2 = int_en2 & MAX31335_INT_EN2_NOWAKE;
+
+	ret = regmap_clear_bits(max31335->regmap, MAX31335_INT_EN1,
+				max31335->suspend_int_en1);
+	if (!ret && max31335->chip->temp)
+		ret = regmap_clear_bits(max31335->regmap, MAX31335_INT_EN2,
+					max31335->suspend_int_en2);
+	if (ret)
+		max31335_irq_restore(max31335);
+
+	return ret;
+}
+
+/*
+ * The late phase runs after the RTC core and alarmtimer have programmed the
+ * wakeup alarm, so no register writes are expected while suspended. The
+ * device is battery backed and keeps its state; the cache is only put in
+ * cache-only mode so that anything written meanwhile is synced on resume.
+ * Without an intervening write regcache_sync() has nothing to do.
+ */
+static int max31335_suspend(struct device *dev)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+	struct i2c_client *client = to_i2c_client(dev);
+	int ret;
+
+	if (client->irq <= 0)
+		goto cache_only;
+
+	/*
+	 * Only the alarms and the timer should wake the system: temperature,
+	 * power and timestamp input events are masked until resume.
+	 */
+	ret = max31335_irq_suspend(max31335);
+	if (ret)
+		return ret;
+
+	if (device_may_wakeup(dev))
+		enable_irq_wake(client->irq);
+
+	/* the handler needs the bus, keep it off until resume */
+	disable_irq(client->irq);
+
+cache_only:
+	regcache_cache_only(max31335->regmap, true);
+
+	return 0;
+}
+
+/*
+ * The interrupt is re-enabled and the wake source disarmed even when the
+ * bus fails here, so the device is never left half suspended. The first
+ * error is reported.
+ */
+static int max31335_resume(struct device *dev)
+{
+	struct max31335_data *max31335 = dev_get_drvdata(dev);
+	struct i2c_client *client = to_i2c_client(dev);
+	int ret, err;
+
+	regcache_cache_only(max31335->regmap, false);
+
+	ret = regcache_sync(max31335->regmap);
 
-	return max31335_trickle_charger_setup(&client->dev, max31335);
+	if (client->irq <= 0)
+		return ret;
+
+	if (max31335->temp_irq)
+		WRITE_ONCE(max31335->temp_valid, false);
+
+	err = max31335_irq_restore(max31335);
+	if (!ret)
+		ret = err;
+
+	enable_irq(client->irq);
+
+	if (device_may_wakeup(dev))
+		disable_irq_wake(client->irq);
+
+	return ret;
 }
 
+static const struct dev_pm_ops max31335_pm_ops = {
+	LATE_SYSTEM_SLEEP_PM_OPS(max31335_suspend, max31335_resume)
+};
+
 static const struct i2c_device_id max31335_id[] = {
-	{ "max31335", 0 },
+	{ "max31331", (kernel_ulong_t)&max31331_chip_info },
+	{ "max31335", (kernel_ulong_t)&max31335_chip_info },
+	MAX31335_EMUL_ID("max31331", max31331_chip_info)
+	MAX31335_EMUL_ID("max31335", max31335_chip_info)
 	{ }
 };
 
 MODULE_DEVICE_TABLE(i2c, max31335_id);
 
 static const struct of_device_id max31335_of_match[] = {
-	{ .compatible = "adi,max31335" },
+	{ .compatible = "adi,max31331", .data = &max31331_chip_info },
+	{ .compatible = "adi,max31335", .data = &max31335_chip_info },
 	{ }
 };
 
@@ -731,6 +3943,8 @@ static struct i2c_driver max31335_driver = {
 	.driver = {
 		.name = "rtc-max31335",
 		.of_match_table = max31335_of_match,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+		.pm = pm_sleep_ptr(&max31335_pm_ops),
 	},
 	.probe = max31335_probe,
 	.id_table = max31335_id,
@@ -0,0 +1,938 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Benchmark and stress harness for the MAX31331/MAX31335 RTC driver
+ *
+ * Copyright (C) 2023 Analog Devices
+ *
+ * Runs the driver's hot paths in tight loops from one or more threads and
+ * reports throughput and latency percentiles, or measures how long alarm
+ * and timer interrupts take to reach userspace. The driver's debugfs knobs
+ * select cached/uncached and burst/single-register configurations, and its
+ * stats file is reset before and dumped after every run.
+ *
+ * Build:
+ *	gcc -O2 -Wall -pthread -I../include/uapi -o max31335-bench \
+ *		max31335-bench.c
+ *
+ * Examples:
+ *	max31335-bench -d /dev/rtc0 -t 4 -s 5 rd_time alm_read temp
+ *	max31335-bench -d /dev/rtc0 -m -S rd_time alm_read nvmem_read
+ *	max31335-bench -d /dev/rtc0 -n 20 alarm
+ *	max31335-bench -d /dev/rtc0 -n 200 -p 250 timer
+ *
+ * Latency workloads need debugfs mounted and root for the knobs, and the
+ * nvmem_write workload restores the RAM contents it overwrote on exit.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <glob.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/rtc.h>
+#include <linux/rtc-max31335.h>
+
+#define NSEC_PER_SEC	1000000000ULL
+#define NSEC_PER_USEC	1000ULL
+#define NVMEM_MAX	64
+/* device, class and debugfs names, with room left for a file name */
+#define NAME_LEN	256
+
+struct bench;
+struct worker;
+
+struct workload {
+	const char *name;
+	int (*setup)(struct bench *b, struct worker *w);
+	int (*op)(struct bench *b, struct worker *w);
+	void (*teardown)(struct bench *b, struct worker *w);
+};
+
+/* per thread state and latency samples, in nanoseconds */
+struct worker {
+	pthread_t thread;
+	struct bench *b;
+	const struct workload *wl;
+	unsigned int id;
+	int fd;
+	uint64_t *lat;
+	size_t n, cap;
+	uint64_t errors;
+	int last_errno;
+	uint64_t seq;
+};
+
+struct bench {
+	char rtc_dev[NAME_LEN];
+	char rtc_sys[NAME_LEN];
+	char debugfs[NAME_LEN];
+	char hwmon[PATH_MAX];
+	char nvmem[PATH_MAX];
+	char events[NAME_LEN];
+	unsigned int threads;
+	unsigned long iterations;
+	unsigned int seconds;
+	unsigned int period_ms;
+	bool matrix;
+	bool stats;
+	int cache_bypass;
+	int single_xfer;
+	int xfer_delay_us;
+	struct rtc_time base;
+	uint8_t nvmem_saved[NVMEM_MAX];
+	ssize_t nvmem_size;
+	pthread_barrier_t barrier;
+	uint64_t deadline;
+};
+
+static uint64_t now_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int sysfs_read(const char *path, char *buf, size_t len)
+{
+	ssize_t n;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	n = read(fd, buf, len - 1);
+	close(fd);
+	if (n < 0)
+		return -errno;
+
+	buf[n] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+
+	return 0;
+}
+
+static int sysfs_write(const char *path, const char *val)
+{
+	ssize_t n;
+	int fd;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -errno;
+
+	n = write(fd, val, strlen(val));
+	close(fd);
+
+	return n < 0 ? -errno : 0;
+}
+
+/* first match of @pattern, or an empty string */
+static void find_path(char *out, size_t len, const char *pattern)
+{
+	glob_t g;
+
+	out[0] = '\0';
+	if (glob(pattern, 0, NULL, &g))
+		return;
+
+	snprintf(out, len, "%s", g.gl_pathv[0]);
+	globfree(&g);
+}
+
+/* locate the sysfs, debugfs, hwmon, nvmem and events nodes of the RTC */
+static void bench_paths(struct bench *b)
+{
+	char path[PATH_MAX], link[PATH_MAX], dev[NAME_LEN];
+	const char *rtc;
+	ssize_t n;
+
+	snprintf(dev, sizeof(dev), "%s", b->rtc_dev);
+	rtc = basename(dev);
+
+	snprintf(b->rtc_sys, sizeof(b->rtc_sys), "/sys/class/rtc/%s", rtc);
+	snprintf(b->events, sizeof(b->events), "/dev/%s-events", rtc);
+
+	snprintf(path, sizeof(path), "%s/device/hwmon/hwmon*/temp1_input",
+		 b->rtc_sys);
+	find_path(b->hwmon, sizeof(b->hwmon), path);
+
+	snprintf(path, sizeof(path), "%s/device/max31335_nvram*/nvmem",
+		 b->rtc_sys);
+	find_path(b->nvmem, sizeof(b->nvmem), path);
+	if (!b->nvmem[0])
+		find_path(b->nvmem, sizeof(b->nvmem),
+			  "/sys/bus/nvmem/devices/max31335_nvram*/nvmem");
+
+	if (b->debugfs[0])
+		return;
+
+	snprintf(path, sizeof(path), "%s/device", b->rtc_sys);
+	n = readlink(path, link, sizeof(link) - 1);
+	if (n < 0)
+		return;
+
+	link[n] = '\0';
+	snprintf(b->debugfs, sizeof(b->debugfs),
+		 "/sys/kernel/debug/max31335-%s", basename(link));
+}
+
+static int knob_set(struct bench *b, const char *knob, int val)
+{
+	char path[PATH_MAX], buf[16];
+	int ret;
+
+	if (val < 0)
+		return 0;
+
+	snprintf(path, sizeof(path), "%s/%s", b->debugfs, knob);
+	snprintf(buf, sizeof(buf), "%d", val);
+	ret = sysfs_write(path, buf);
+	if (ret)
+		fprintf(stderr, "cannot set %s: %s\n", path, strerror(-ret));
+
+	return ret;
+}
+
+static void stats_reset(struct bench *b)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/stats", b->debugfs);
+	sysfs_write(path, "0");
+}
+
+static void stats_dump(struct bench *b)
+{
+	char path[PATH_MAX], line[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/stats", b->debugfs);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+
+	printf("--- %s\n", path);
+	while (fgets(line, sizeof(line), f))
+		fputs(line, stdout);
+
+	fclose(f);
+}
+
+static int open_rtc(struct bench *b, struct worker *w)
+{
+	w->fd = open(b->rtc_dev, O_RDONLY);
+
+	return w->fd < 0 ? -errno : 0;
+}
+
+static int open_hwmon(struct bench *b, struct worker *w)
+{
+	if (!b->hwmon[0])
+		return -ENOENT;
+
+	w->fd = open(b->hwmon, O_RDONLY);
+
+	return w->fd < 0 ? -errno : 0;
+}
+
+static int open_nvmem(struct bench *b, struct worker *w)
+{
+	if (!b->nvmem[0])
+		return -ENOENT;
+
+	w->fd = open(b->nvmem, O_RDWR);
+
+	return w->fd < 0 ? -errno : 0;
+}
+
+static int open_wakealarm(struct bench *b, struct worker *w)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/wakealarm", b->rtc_sys);
+	w->fd = open(path, O_WRONLY);
+
+	return w->fd < 0 ? -errno : 0;
+}
+
+static void close_fd(struct bench *b, struct worker *w)
+{
+	if (w->fd >= 0)
+		close(w->fd);
+}
+
+static int op_rd_time(struct bench *b, struct worker *w)
+{
+	struct rtc_time tm;
+
+	return ioctl(w->fd, RTC_RD_TIME, &tm) ? -errno : 0;
+}
+
+static int op_alm_read(struct bench *b, struct worker *w)
+{
+	struct rtc_time tm;
+
+	return ioctl(w->fd, RTC_ALM_READ, &tm) ? -errno : 0;
+}
+
+/* move the alarm around within a minute, so every call writes registers */
+static int op_alm_set(struct bench *b, struct worker *w)
+{
+	struct rtc_time tm = b->base;
+
+	tm.tm_sec = (w->seq++ + w->id) % 60;
+
+	return ioctl(w->fd, RTC_ALM_SET, &tm) ? -errno : 0;
+}
+
+/* one op is a full arm and disarm through the RTC core's sysfs file */
+static int op_wakealarm(struct bench *b, struct worker *w)
+{
+	if (pwrite(w->fd, "+3600", 5, 0) < 0)
+		return -errno;
+
+	return pwrite(w->fd, "0", 1, 0) < 0 ? -errno : 0;
+}
+
+static int op_temp(struct bench *b, struct worker *w)
+{
+	char buf[16];
+
+	return pread(w->fd, buf, sizeof(buf), 0) < 0 ? -errno : 0;
+}
+
+static int op_nvmem_read(struct bench *b, struct worker *w)
+{
+	uint8_t buf[NVMEM_MAX];
+
+	return pread(w->fd, buf, b->nvmem_size, 0) < 0 ? -errno : 0;
+}
+
+static int op_nvmem_write(struct bench *b, struct worker *w)
+{
+	uint8_t val = w->seq++;
+	off_t off = w->id % b->nvmem_size;
+
+	return pwrite(w->fd, &val, 1, off) < 0 ? -errno : 0;
+}
+
+static const struct workload workloads[] = {
+	{ "rd_time", open_rtc, op_rd_time, close_fd },
+	{ "alm_read", open_rtc, op_alm_read, close_fd },
+	{ "alm_set", open_rtc, op_alm_set, close_fd },
+	{ "wakealarm", open_wakealarm, op_wakealarm, close_fd },
+	{ "temp", open_hwmon, op_temp, close_fd },
+	{ "nvmem_read", open_nvmem, op_nvmem_read, close_fd },
+	{ "nvmem_write", open_nvmem, op_nvmem_write, close_fd },
+};
+
+static int sample_add(struct worker *w, uint64_t ns)
+{
+	uint64_t *lat;
+
+	if (w->n == w->cap) {
+		w->cap = w->cap ? w->cap * 2 : 4096;
+		lat = realloc(w->lat, w->cap * sizeof(*lat));
+		if (!lat)
+			return -ENOMEM;
+
+		w->lat = lat;
+	}
+
+	w->lat[w->n++] = ns;
+
+	return 0;
+}
+
+static void *worker_run(void *arg)
+{
+	struct worker *w = arg;
+	struct bench *b = w->b;
+	unsigned long i;
+	uint64_t t0, t1;
+	int ret;
+
+	pthread_barrier_wait(&b->barrier);
+
+	for (i = 0; !b->iterations || i < b->iterations; i++) {
+		t0 = now_ns(CLOCK_MONOTONIC);
+		ret = w->wl->op(b, w);
+		t1 = now_ns(CLOCK_MONOTONIC);
+
+		if (ret) {
+			w->errors++;
+			w->last_errno = -ret;
+		}
+
+		if (sample_add(w, t1 - t0))
+			break;
+
+		if (b->deadline && t1 >= b->deadline)
+			break;
+	}
+
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* nearest rank: the smallest sample covering @pct of the population */
+static uint64_t percentile(const uint64_t *lat, size_t n, double pct)
+{
+	size_t rank = (size_t)(pct * n + 0.999999);
+
+	if (!n)
+		return 0;
+
+	return lat[rank ? rank - 1 : 0];
+}
+
+static void report(const char *name, const char *config, uint64_t *lat,
+		   size_t n, uint64_t errors, int last_errno, uint64_t elapsed)
+{
+	qsort(lat, n, sizeof(*lat), cmp_u64);
+
+	printf("%-12s %-16s %9zu %7" PRIu64 " %10.0f %9.1f %9.1f %9.1f %9.1f",
+	       name, config, n, errors,
+	       elapsed ? n * (double)NSEC_PER_SEC / elapsed : 0,
+	       percentile(lat, n, 0.50) / (double)NSEC_PER_USEC,
+	       percentile(lat, n, 0.99) / (double)NSEC_PER_USEC,
+	       percentile(lat, n, 0.999) / (double)NSEC_PER_USEC,
+	       n ? lat[n - 1] / (double)NSEC_PER_USEC : 0);
+
+	if (errors)
+		printf("  (%s)", strerror(last_errno));
+
+	putchar('\n');
+}
+
+static void report_header(void)
+{
+	printf("%-12s %-16s %9s %7s %10s %9s %9s %9s %9s\n", "workload",
+	       "config", "ops", "errors", "ops/s", "p50_us", "p99_us",
+	       "p999_us", "max_us");
+}
+
+static int nvmem_save(struct bench *b)
+{
+	int fd;
+
+	fd = open(b->nvmem, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	b->nvmem_size = pread(fd, b->nvmem_saved, sizeof(b->nvmem_saved), 0);
+	close(fd);
+
+	return b->nvmem_size > 0 ? 0 : -EIO;
+}
+
+static void nvmem_restore(struct bench *b)
+{
+	int fd;
+
+	fd = open(b->nvmem, O_WRONLY);
+	if (fd < 0)
+		return;
+
+	if (pwrite(fd, b->nvmem_saved, b->nvmem_size, 0) != b->nvmem_size)
+		fprintf(stderr, "cannot restore %s\n", b->nvmem);
+
+	close(fd);
+}
+
+static int run_workload(struct bench *b, const struct workload *wl,
+			const char *config)
+{
+	struct worker *w;
+	uint64_t *lat, start, elapsed, errors = 0;
+	size_t n = 0;
+	unsigned int i;
+	int ret = 0, last_errno = 0;
+
+	w = calloc(b->threads, sizeof(*w));
+	if (!w)
+		return -ENOMEM;
+
+	for (i = 0; i < b->threads; i++) {
+		w[i].b = b;
+		w[i].wl = wl;
+		w[i].id = i;
+		w[i].fd = -1;
+
+		ret = wl->setup(b, &w[i]);
+		if (ret) {
+			fprintf(stderr, "%s: setup failed: %s\n", wl->name,
+				strerror(-ret));
+			goto out;
+		}
+	}
+
+	if (b->stats)
+		stats_reset(b);
+
+	pthread_barrier_init(&b->barrier, NULL, b->threads + 1);
+
+	for (i = 0; i < b->threads; i++)
+		pthread_create(&w[i].thread, NULL, worker_run, &w[i]);
+
+	start = now_ns(CLOCK_MONOTONIC);
+	b->deadline = b->seconds ? start + b->seconds * NSEC_PER_SEC : 0;
+	pthread_barrier_wait(&b->barrier);
+
+	for (i = 0; i < b->threads; i++) {
+		pthread_join(w[i].thread, NULL);
+		n += w[i].n;
+		errors += w[i].errors;
+		if (w[i].errors)
+			last_errno = w[i].last_errno;
+	}
+
+	elapsed = now_ns(CLOCK_MONOTONIC) - start;
+	pthread_barrier_destroy(&b->barrier);
+
+	lat = malloc((n ? n : 1) * sizeof(*lat));
+	if (!lat) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (n = 0, i = 0; i < b->threads; i++) {
+		memcpy(lat + n, w[i].lat, w[i].n * sizeof(*lat));
+		n += w[i].n;
+	}
+
+	report(wl->name, config, lat, n, errors, last_errno, elapsed);
+	free(lat);
+
+	if (b->stats)
+		stats_dump(b);
+
+out:
+	for (i = 0; i < b->threads; i++) {
+		if (wl->teardown)
+			wl->teardown(b, &w[i]);
+		free(w[i].lat);
+	}
+
+	free(w);
+
+	return ret;
+}
+
+/* wait for the next record carrying @type, or time out after @ms */
+static int event_wait(int fd, enum max31335_event_type type, int ms,
+		      struct max31335_event *ev)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	int ret;
+
+	for (;;) {
+		ret = poll(&pfd, 1, ms);
+		if (ret < 0)
+			return -errno;
+		if (!ret)
+			return -ETIMEDOUT;
+		if (pfd.revents & POLLHUP)
+			return -ENODEV;
+
+		if (read(fd, ev, sizeof(*ev)) != sizeof(*ev))
+			return -errno;
+
+		if (ev->events & (1U << type))
+			return 0;
+	}
+}
+
+/*
+ * Alarm delivery: arm Alarm1 two seconds ahead through the RTC core and
+ * take the time when the blocking read on /dev/rtcN returns. With the
+ * events device, the latency counted is from the interrupt edge stamped by
+ * the driver; without it, from the system clock's second boundary, which
+ * includes any offset between the RTC and the system time.
+ */
+static int run_alarm(struct bench *b)
+{
+	struct max31335_event ev;
+	struct rtc_time tm;
+	struct tm cal;
+	uint64_t *lat, t;
+	time_t alarm;
+	unsigned long i, n = b->iterations ? b->iterations : 10;
+	unsigned long data;
+	size_t done = 0;
+	int fd, efd, ret = 0;
+
+	fd = open(b->rtc_dev, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	efd = open(b->events, O_RDONLY | O_NONBLOCK);
+
+	lat = calloc(n, sizeof(*lat));
+	if (!lat) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (b->stats)
+		stats_reset(b);
+
+	for (i = 0; i < n; i++) {
+		if (ioctl(fd, RTC_RD_TIME, &tm)) {
+			ret = -errno;
+			break;
+		}
+
+		cal = (struct tm) {
+			.tm_sec = tm.tm_sec, .tm_min = tm.tm_min,
+			.tm_hour = tm.tm_hour, .tm_mday = tm.tm_mday,
+			.tm_mon = tm.tm_mon, .tm_year = tm.tm_year,
+		};
+		alarm = timegm(&cal) + 2;
+		gmtime_r(&alarm, &cal);
+		tm.tm_sec = cal.tm_sec;
+		tm.tm_min = cal.tm_min;
+		tm.tm_hour = cal.tm_hour;
+		tm.tm_mday = cal.tm_mday;
+		tm.tm_mon = cal.tm_mon;
+		tm.tm_year = cal.tm_year;
+
+		if (ioctl(fd, RTC_ALM_SET, &tm) || ioctl(fd, RTC_AIE_ON, 0)) {
+			ret = -errno;
+			break;
+		}
+
+		if (read(fd, &data, sizeof(data)) != sizeof(data)) {
+			ret = -errno;
+			break;
+		}
+
+		t = now_ns(efd >= 0 ? CLOCK_MONOTONIC : CLOCK_REALTIME);
+		ioctl(fd, RTC_AIE_OFF, 0);
+
+		if (efd < 0) {
+			lat[done++] = t % NSEC_PER_SEC;
+			continue;
+		}
+
+		ret = event_wait(efd, MAX31335_EVENT_ALARM1, 1000, &ev);
+		if (ret)
+			break;
+
+		lat[done++] = t - ev.time_ns;
+	}
+
+	report("alarm", efd >= 0 ? "irq->read" : "second->read", lat, done,
+	       ret ? 1 : 0, -ret, 0);
+
+	if (b->stats)
+		stats_dump(b);
+
+	free(lat);
+out:
+	if (efd >= 0)
+		close(efd);
+	close(fd);
+
+	return ret;
+}
+
+/*
+ * Timer delivery: run the countdown timer in repeat mode and read its
+ * records from the events device. Both the interrupt to userspace latency
+ * and the deviation of each period from the programmed one are reported.
+ */
+static int run_timer(struct bench *b)
+{
+	char path[PATH_MAX], buf[16];
+	struct max31335_event ev;
+	uint64_t *lat, *jitter, prev = 0, t;
+	unsigned long i, n = b->iterations ? b->iterations : 100;
+	unsigned long merged = 0;
+	size_t done = 0, periods = 0;
+	int efd, ret = 0;
+
+	efd = open(b->events, O_RDONLY | O_NONBLOCK);
+	if (efd < 0) {
+		fprintf(stderr, "%s: %s\n", b->events, strerror(errno));
+		return -errno;
+	}
+
+	lat = calloc(n, sizeof(*lat));
+	jitter = calloc(n, sizeof(*jitter));
+	if (!lat || !jitter) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	snprintf(path, sizeof(path), "%s/timer_repeat", b->rtc_sys);
+	ret = sysfs_write(path, "1");
+	if (ret)
+		goto out;
+
+	if (b->stats)
+		stats_reset(b);
+
+	snprintf(path, sizeof(path), "%s/timer_ms", b->rtc_sys);
+	snprintf(buf, sizeof(buf), "%u", b->period_ms);
+	ret = sysfs_write(path, buf);
+	if (ret)
+		goto out;
+
+	/* the period actually programmed, after rounding to the source clock */
+	if (!sysfs_read(path, buf, sizeof(buf)))
+		b->period_ms = strtoul(buf, NULL, 0);
+
+	for (i = 0; i < n; i++) {
+		ret = event_wait(efd, MAX31335_EVENT_TIMER,
+				 b->period_ms * 4 + 1000, &ev);
+		if (ret)
+			break;
+
+		t = now_ns(CLOCK_MONOTONIC);
+		lat[done++] = t - ev.time_ns;
+		merged += ev.count - 1;
+
+		if (prev && ev.count == 1) {
+			int64_t d = ev.time_ns - prev -
+				    b->period_ms * 1000000ULL;
+
+			jitter[periods++] = d < 0 ? -d : d;
+		}
+
+		prev = ev.time_ns;
+	}
+
+	sysfs_write(path, "0");
+
+	report("timer", "irq->read", lat, done, ret ? 1 : 0, -ret, 0);
+	report("timer", "period-error", jitter, periods, 0, 0, 0);
+	if (merged)
+		printf("timer: %lu interrupts merged while the reader lagged\n",
+		       merged);
+
+	if (b->stats)
+		stats_dump(b);
+
+out:
+	free(jitter);
+	free(lat);
+	close(efd);
+
+	return ret;
+}
+
+static const struct workload *workload_find(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+		if (!strcmp(workloads[i].name, name))
+			return &workloads[i];
+
+	return NULL;
+}
+
+static void usage(const char *prog)
+{
+	size_t i;
+
+	fprintf(stderr,
+		"usage: %s [options] workload...\n"
+		"  -d DEV     RTC character device (default /dev/rtc0)\n"
+		"  -t N       threads per workload (default 1)\n"
+		"  -n N       iterations per thread, or events to wait for\n"
+		"  -s SEC     run each workload for SEC seconds (default 2)\n"
+		"  -p MS      timer period for the timer workload (default 100)\n"
+		"  -D DIR     driver debugfs directory (default derived from DEV)\n"
+		"  -c 0|1     set debugfs cache_bypass\n"
+		"  -x 0|1     set debugfs single_xfer\n"
+		"  -y US      set debugfs xfer_delay_us\n"
+		"  -m         run every workload for each cache_bypass/single_xfer\n"
+		"             combination\n"
+		"  -S         reset and dump the driver stats around each run\n"
+		"workloads: alarm timer", prog);
+
+	for (i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+		fprintf(stderr, " %s", workloads[i].name);
+
+	fputc('\n', stderr);
+}
+
+static int run_one(struct bench *b, const char *name, const char *config)
+{
+	const struct workload *wl;
+
+	if (!strcmp(name, "alarm"))
+		return run_alarm(b);
+	if (!strcmp(name, "timer"))
+		return run_timer(b);
+
+	wl = workload_find(name);
+	if (!wl)
+		return -EINVAL;
+
+	return run_workload(b, wl, config);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench b = {
+		.threads = 1,
+		.seconds = 2,
+		.period_ms = 100,
+		.cache_bypass = -1,
+		.single_xfer = -1,
+		.xfer_delay_us = -1,
+	};
+	bool nvmem_written = false;
+	char config[32];
+	int opt, i, c, x, fd, ret = 0;
+
+	snprintf(b.rtc_dev, sizeof(b.rtc_dev), "/dev/rtc0");
+
+	while ((opt = getopt(argc, argv, "d:t:n:s:p:D:c:x:y:mSh")) != -1) {
+		switch (opt) {
+		case 'd':
+			snprintf(b.rtc_dev, sizeof(b.rtc_dev), "%s", optarg);
+			break;
+		case 't':
+			b.threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			b.iterations = strtoul(optarg, NULL, 0);
+			b.seconds = 0;
+			break;
+		case 's':
+			b.seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			b.period_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'D':
+			snprintf(b.debugfs, sizeof(b.debugfs), "%s", optarg);
+			break;
+		case 'c':
+			b.cache_bypass = atoi(optarg);
+			break;
+		case 'x':
+			b.single_xfer = atoi(optarg);
+			break;
+		case 'y':
+			b.xfer_delay_us = atoi(optarg);
+			break;
+		case 'm':
+			b.matrix = true;
+			break;
+		case 'S':
+			b.stats = true;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (optind >= argc || !b.threads) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	bench_paths(&b);
+
+	/* alarms are set an hour ahead so none fires during a throughput run */
+	fd = open(b.rtc_dev, O_RDONLY);
+	if (fd < 0 || ioctl(fd, RTC_RD_TIME, &b.base)) {
+		fprintf(stderr, "%s: %s\n", b.rtc_dev, strerror(errno));
+		return 1;
+	}
+	close(fd);
+	b.base.tm_hour = (b.base.tm_hour + 1) % 24;
+
+	/* this also sizes the nvmem workloads */
+	for (i = optind; i < argc; i++) {
+		if (!strncmp(argv[i], "nvmem_", 6) && !b.nvmem_size &&
+		    nvmem_save(&b)) {
+			fprintf(stderr, "cannot read nvmem %s\n", b.nvmem);
+			return 1;
+		}
+
+		if (!strcmp(argv[i], "nvmem_write"))
+			nvmem_written = true;
+	}
+
+	if (knob_set(&b, "xfer_delay_us", b.xfer_delay_us))
+		return 1;
+
+	report_header();
+
+	for (c = 0; c < 2; c++) {
+		for (x = 0; x < 2; x++) {
+			if (b.matrix) {
+				if (knob_set(&b, "cache_bypass", c) ||
+				    knob_set(&b, "single_xfer", x)) {
+					ret = 1;
+					goto out;
+				}
+				snprintf(config, sizeof(config), "%s,%s",
+					 c ? "nocache" : "cache",
+					 x ? "single" : "burst");
+			} else {
+				if (knob_set(&b, "cache_bypass",
+					     b.cache_bypass) ||
+				    knob_set(&b, "single_xfer", b.single_xfer)) {
+					ret = 1;
+					goto out;
+				}
+				snprintf(config, sizeof(config), "default");
+			}
+
+			for (i = optind; i < argc; i++) {
+				int err = run_one(&b, argv[i], config);
+
+				if (err) {
+					fprintf(stderr, "%s: %s\n", argv[i],
+						strerror(-err));
+					ret = 1;
+				}
+			}
+
+			if (!b.matrix)
+				goto out;
+		}
+	}
+
+out:
+	if (b.matrix) {
+		knob_set(&b, "cache_bypass", 0);
+		knob_set(&b, "single_xfer", 0);
+	}
+	if (b.xfer_delay_us > 0)
+		knob_set(&b, "xfer_delay_us", 0);
+	if (nvmem_written)
+		nvmem_restore(&b);
+
+	return ret;
+}